@@ -21,24 +21,28 @@
 /**
  * Firmware for ESP32 running on the base station to send correction data directly to rover over WiFi network.
  * This firmware connects to a WiFi network (modify inputs.h for your settings) and creates a TCP server, 
- * which the rover can connect to.
+ * which up to MAX_CLIENTS rovers can connect to at the same time. The same slots are shared with an
+ * NTRIP v1/v2 caster on NTRIP_PORT serving the mountpoints listed in inputs.h. The stream can also
+ * be pushed to an external caster as an NTRIP server.
  * Stability of the base station's position survey is indicated on the NeoPixel type LED. Red means
- * that no position is found, green means an initial fix is found, but it varies, and blue
- * means that the fix has not changed since the last update.
+ * that no position is found, green means a position is reported but the survey has not converged,
+ * and blue means that the survey has converged (see survey_estimator.h for the criteria).
  * This firmware also displays basic information the information sent and battery if attched,
  * which is available on the ESP32's IP address (printed to serial at startup).
  */
  
  // Libraries
 #include <WiFi.h>
+#include <WiFiUdp.h>
+#include <ESPmDNS.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <SoftwareSerial.h>
 #include <SerialTransfer.h>
 #include <Adafruit_NeoPixel.h>
 #include <esp_task_wdt.h>
-
-#include "ParseRTCM.h"
+#include <lwip/sockets.h>
+#include <driver/uart.h>
 
 // Local files
 #include "inputs.h"
@@ -47,6 +51,21 @@
 #include "rtk.h"
 #include "map.h"
 #include "gnss.h"
+#include "rtcm_framer.h"
+#include "correction_ring.h"
+#include "spsc_ring.h"
+#include "rtcm_decoder.h"
+#include "survey_estimator.h"
+#include "rtcm_filter.h"
+#include "warm_start.h"
+#include "rtcm_stats.h"
+#include "correction_udp.h"
+#include "ntrip_caster.h"
+#include "ntrip_upload.h"
+#include "rtcm_log.h"
+#include "latency.h"
+#include "wifi_supervisor.h"
+#include "discovery.h"
 
 // ESP32 watch dog timer (s)
 #define WDT_TIMEOUT 10
@@ -57,17 +76,125 @@ AsyncWebServer server(80);
 // Event Source on /events
 AsyncEventSource events("/events");
 
+// WiFi link kept up from loop(), see wifi_restart_grace in inputs.h
+WiFiSupervisor wifi_supervisor;
+
 // Communications port to other ESP32
 #define COM_PORT 4081
 
 // Server for communicating RTCM data
 WiFiServer tcp_server(COM_PORT);
 
-// Max RTCM data length
-#define MAX_SERIAL_LENGTH 2500
+// NTRIP caster serving the same RTCM data
+#define NTRIP_PORT 2101
+WiFiServer ntrip_server(NTRIP_PORT);
+
+// Optional UDP transport, frames are sent once to all rovers
+#define UDP_PORT 4082
+WiFiUDP correction_udp;
+uint32_t udp_sequence = 0;
+unsigned long udp_send_errors = 0;
+UDPParityEncoder udp_parity;
+
+// Clock requests from rovers measuring the correction latency
+WiFiUDP time_sync_udp;
+
+// Beacons and probe replies that let rovers find the base station
+WiFiUDP discovery_udp;
+unsigned long next_beacon = 0;
+
+// Time from UART ingest to the socket write of each client write
+LatencyHistogram send_latency;
+
+// Max number of rovers served at the same time
+#define MAX_CLIENTS 8
+
+// Max unsent bytes held for a client before whole frames are dropped
+#define MAX_CLIENT_BACKLOG 4096
+
+// Time a client may keep dropping frames before it is disconnected (ms)
+#define CLIENT_EVICT_TIME 10000
+
+// Time without a dropped frame before a client counts as caught up (ms)
+#define CLIENT_RECOVER_TIME 2000
+
+// Frames are held until their MSM epoch is complete so that each epoch goes
+// out in one write, but never longer than this (ms)
+#define COALESCE_MAX_DELAY 5
+
+// Coalescing statistics: writes to clients, frames completed by them and
+// time since UART ingest of the oldest frame of each write (us)
+unsigned long coalesce_writes = 0;
+unsigned long coalesce_frames = 0;
+uint64_t coalesce_hold_total = 0;
+unsigned long coalesce_hold_max = 0;
 
-// Remote client handle
-WiFiClient remote_client;
+// Protocol spoken by a client
+#define CLIENT_RAW 0
+#define CLIENT_NTRIP_REQUEST 1
+#define CLIENT_NTRIP_V1 2
+#define CLIENT_NTRIP_V2 3
+
+// Connected rover, reading the shared correction ring through its own cursor
+struct RoverClient
+{
+    bool active;
+    uint8_t protocol;
+    WiFiClient client;
+    unsigned long connect_time;
+    // Receiving corrections, false while an NTRIP request is pending
+    bool streaming;
+    RingCursor cursor;
+    unsigned long bytes_sent;
+    // Time the client first fell behind, zero while keeping up, and the
+    // last time it lost frames
+    unsigned long behind_since;
+    unsigned long last_loss;
+    // Sending the warm start snapshot, which one, bytes of it already sent
+    // and when it started
+    bool warm_start;
+    uint8_t warm_snapshot;
+    uint16_t warm_offset;
+    unsigned long warm_start_time;
+    // Live frames held back until the next epoch starts, when the frames
+    // following the snapshot had already been overwritten
+    bool wait_for_epoch;
+    // Latency messages asked for over the time sync port, and the message
+    // for the last epoch still to be sent
+    bool latency_markers;
+    uint8_t marker[LATENCY_FRAME_LENGTH];
+    uint8_t marker_length;
+    uint8_t marker_sent;
+    // NTRIP request header received so far
+    char request[NTRIP_MAX_REQUEST + 1];
+    uint16_t request_length;
+    // Chunked transfer framing not yet sent and payload left in the open chunk
+    char chunk_prefix[16];
+    uint8_t prefix_length;
+    uint8_t prefix_sent;
+    uint32_t chunk_remaining;
+    bool chunk_open;
+};
+RoverClient rover_clients[MAX_CLIENTS];
+int num_clients = 0;
+
+// RTCM frames shared by all rover clients
+CorrectionRing correction_ring;
+
+// Latest station messages and MSM epoch, sent to newly connected clients
+WarmStartCache warm_start;
+
+// Flash recording of the correction stream, indexed by the GPS time of week
+// (ms) of the last GPS MSM epoch
+RTCMLog rtcm_log;
+uint32_t gps_epoch_time = 0;
+
+// Optional upload to an external caster, reading the ring like a client
+NtripUpload caster_upload;
+RingCursor upload_cursor;
+
+// Max unsent bytes held for the caster upload before whole frames are dropped
+#define MAX_UPLOAD_BACKLOG 8192
 
 // Software serial connection for TinkerNav data
 SoftwareSerial tinkernav_serial;
@@ -94,22 +221,41 @@ int update_period = 2000;
 // Number of RTCM data packages sent
 unsigned long num_rtcm_uploads = 0;
 
+// GNSS receiver UART, read by a dedicated ingest task
+#define GNSS_UART UART_NUM_1
+#define GNSS_RX_PIN 21
+#define GNSS_TX_PIN 20
+#define GNSS_UART_BUFFER 2048
+
+// Number of bytes in the RX FIFO that wake the ingest task, and the idle
+// time (in symbol times) after which a partly filled FIFO is also handed over
+#define GNSS_RX_FULL_THRESHOLD 64
+#define GNSS_RX_TIMEOUT 4
+
+// UART event queue and bytes passed from the ingest task to loop()
+QueueHandle_t gnss_uart_queue;
+SPSCRing uart_ring;
+
+// Bytes lost because the ring or the UART FIFO/buffer were full
+volatile unsigned long uart_overrun_bytes = 0;
+volatile unsigned long uart_overrun_events = 0;
+
 // LED indicator
 #define NEO_PIN 4
 Adafruit_NeoPixel pixels(1, NEO_PIN, NEO_GRB + NEO_KHZ800);
 
 // RTCM parsing variables
-PARSERTCM rtcm_parser;
-char rtcm_data[MAX_SERIAL_LENGTH];
+RTCMFramer rtcm_framer;
+RTCMDecoder rtcm_decoder;
+RTCMFilter rtcm_filter;
+RTCMStats rtcm_stats;
 String rtk_rec_mode = "Rover";
-bool data_available = false;
-unsigned int data_length = 0;
-int data_counter = 0;
 
 double latitude;
 double longitude;
 
 // Base station survey
+SurveyEstimator survey;
 bool survey_complete = false;
 String survey_complete_string = "Incomplete";
 
@@ -139,13 +285,27 @@ void setup()
     tinkernav_serial.begin(9600, SWSERIAL_8N1, 1, 0);
     transfer_from_nav.begin(tinkernav_serial);
 
+    // RTCM frame validation
+    crc24qInit();
+
+    // Flash recording of the correction stream
+    if (rtcm_log_enabled && !rtcm_log.begin())
+    {
+        Serial.println("RTCM log disabled, LittleFS mount failed");
+    }
+
     // GNSS hardware serial connection (rx/tx)
     // Receives RTCM correction data from the PX1125R
-    Serial1.begin(115200, SERIAL_8N1, 21, 20);
+    startUartIngest();
 
     // Connect to WiFi
     Serial.print("Connecting to WiFi .");
-    connectWiFi();
+    if (wifi_static_ip)
+    {
+        wifi_supervisor.setStaticIP(wifi_ip, wifi_gateway, wifi_subnet, wifi_dns);
+    }
+    wifi_supervisor.begin(ssid, password, wifi_restart_grace * 1000UL, wifi_fast_connect, wifi_reuse_lease);
+    wifi_supervisor.waitForConnection();
 
     // Home page
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
@@ -204,6 +364,60 @@ void setup()
       request->send_P(200, "text/plain", lat_lng);
     });
 
+    // Per message type RTCM statistics
+    server.on("/rtcm_stats", HTTP_GET, [](AsyncWebServerRequest *request)
+    {
+        static char json[RTCM_STATS_JSON_SIZE];
+        rtcm_stats.toJSON(json, sizeof(json));
+        request->send(200, "application/json", json);
+    });
+
+    // Time from UART ingest to the socket write to a client (ms)
+    server.on("/latency", HTTP_GET, [](AsyncWebServerRequest *request)
+    {
+        char json[160];
+        send_latency.toJSON(json, sizeof(json));
+        request->send(200, "application/json", json);
+    });
+
+    // Recorded RTCM segments and the GPS time of week (ms) they cover
+    server.on("/rtcm_log_index", HTTP_GET, [](AsyncWebServerRequest *request)
+    {
+        static char json[2048];
+        rtcm_log.indexJSON(json, sizeof(json));
+        request->send(200, "application/json", json);
+    });
+
+    // Download the recorded RTCM stream, optionally limited to a range of
+    // GPS time of week given in seconds
+    server.on("/rtcm_log", HTTP_GET, [](AsyncWebServerRequest *request)
+    {
+        uint32_t from = 0;
+        uint32_t to = 0xFFFFFFFF;
+        if (request->hasParam("from"))
+        {
+            from = request->getParam("from")->value().toInt() * 1000UL;
+        }
+        if (request->hasParam("to"))
+        {
+            to = request->getParam("to")->value().toInt() * 1000UL;
+        }
+
+        RTCMLogReader* reader = new RTCMLogReader();
+        reader->num_spans = rtcm_log.selectRange(from, to, reader->spans, RTCM_LOG_SEGMENTS);
+        AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", reader->length(),
+            [reader](uint8_t *buffer, size_t max_length, size_t index) -> size_t
+            {
+                return reader->read(buffer, max_length);
+            });
+        response->addHeader("Content-Disposition", "attachment; filename=\"base.rtcm3\"");
+        request->onDisconnect([reader]()
+        {
+            delete reader;
+        });
+        request->send(response);
+    });
+
     // Handle Web Server Events
     events.onConnect([](AsyncEventSourceClient *client)
     {
@@ -217,6 +431,25 @@ void setup()
     server.begin();
 
     tcp_server.begin();
+    ntrip_server.begin();
+    time_sync_udp.begin(TIME_SYNC_PORT);
+
+    // Announce the base station to rovers and to mDNS / DNS-SD browsers
+    discovery_udp.begin(DISCOVERY_PORT);
+    if (MDNS.begin(base_hostname))
+    {
+        MDNS.addService("rtcm", "tcp", COM_PORT);
+        MDNS.addService("ntrip", "tcp", NTRIP_PORT);
+        MDNS.addServiceTxt("ntrip", "tcp", "mountpoint", ntrip_mountpoints[0]);
+        Serial.print("mDNS name ");Serial.print(base_hostname);Serial.println(".local");
+    }
+
+    // Caster upload connects from loop() once running
+    if (ntrip_upload_enabled)
+    {
+        caster_upload.begin(ntrip_upload_host, ntrip_upload_port, ntrip_upload_mountpoint,
+                            ntrip_upload_user, ntrip_upload_password, ntrip_upload_v2);
+    }
 
 }
 
@@ -227,6 +460,9 @@ void loop()
     // so that the hardware doesn't reset
     esp_task_wdt_reset();
 
+    // Track the WiFi link and reconnect in the background
+    wifi_supervisor.service();
+
     // Receive serial data from TinkerCharge via RP2040
     if (transfer_from_nav.available())
     {
@@ -237,44 +473,57 @@ void loop()
 
     // Check for client connections
     checkForConnections();
+    serveNtripRequests();
+
+    // Answer rover clock requests
+    serveTimeSync();
+
+    // Answer rover probes and send the periodic beacon
+    serveDiscovery();
+
+    // Read RTCM data and store complete frames for the clients
+    if (uart_ring.available())
+    {
+        readSerialAndForward();
+    }
+
+    // Send stored frames to each client
+    sendToClients();
 
-    // Read RTCM data and send to client if connected and data is available
-    if (remote_client.connected() && Serial1.available())
+    // Send stored frames to the external caster
+    if (ntrip_upload_enabled)
     {
-        readSerialBufferAndSend();
+        sendToCaster();
     }
 
-    // Set indicator based on status of lat/long report
-    if (data_available)
+    // Update survey estimate and set indicator on each station position report
+    if (rtcm_decoder.station_updated)
     {
-        data_available = false;
-    
-        rtcm_parser.ReadData(rtcm_data,data_length);
+        rtcm_decoder.station_updated = false;
 
-        static double ecef_rss_last = 0;
-        double ecef_rss = sqrt(rtcm_parser.data_struct.ecef[0]*rtcm_parser.data_struct.ecef[0] +
-                               rtcm_parser.data_struct.ecef[1]*rtcm_parser.data_struct.ecef[1] +
-                               rtcm_parser.data_struct.ecef[2]*rtcm_parser.data_struct.ecef[2]);
-        Serial.print("ECEF RSS = ");Serial.println(ecef_rss);
+        survey.addSample(rtcm_decoder.ecef, millis());
 
-        // Latitude and Longitude reported and did not vary since last report
-        if(ecef_rss > 1 && fabs(ecef_rss_last-ecef_rss) < 0.001)
+        // Survey converged
+        if (survey.converged())
         {
-            latitude = rtcm_parser.getLatitude();
-            longitude = rtcm_parser.getLongitude();
-            
+            latitude = rtcm_decoder.latitude();
+            longitude = rtcm_decoder.longitude();
+
+            if (!survey_complete)
+            {
+                Serial.print(millis());Serial.print(" Survey complete, sigma (m) = ");Serial.println(survey.meanSigma(), 4);
+            }
             survey_complete = true;
             survey_complete_string = "Complete";
             pixels.setPixelColor(0, pixels.Color(0, 0, 50));
             pixels.show();
         }
-        // First latitude and longitude values available, but not stable
-        else if (ecef_rss > 1)
+        // Position available, but not converged
+        else if (survey.hasPosition())
         {
+            latitude = rtcm_decoder.latitude();
+            longitude = rtcm_decoder.longitude();
 
-            latitude = rtcm_parser.getLatitude();
-            longitude = rtcm_parser.getLongitude();
-            
             survey_complete = false;
             survey_complete_string = "Incomplete";
             pixels.setPixelColor(0, pixels.Color(0, 50, 0));
@@ -288,17 +537,12 @@ void loop()
             pixels.setPixelColor(0, pixels.Color(50, 0, 0));
             pixels.show();
         }
-
-        ecef_rss_last = ecef_rss;
     }
 
     // Update data on webpage
     if (millis() > next_update) 
     {
 
-        // Check connection to WiFi and reconnect if needed
-        connectWiFi();
-        
         // Send Events to update webpages
         events.send("ping",NULL,millis());
         events.send(String(data_for_tinkersend.voltage).c_str(),"voltage",millis());
@@ -309,89 +553,956 @@ void loop()
         events.send(String(data_for_tinkersend.SOC).c_str(),"battery_soc",millis());
         events.send(String(data_for_tinkersend.temperature).c_str(),"tc_temp",millis());
         events.send(String(millis()/1000.0/60.0).c_str(),"up_time",millis());
+        events.send(wifi_supervisor.status().c_str(),"wifi_status",millis());
+        events.send(wifi_supervisor.bootTiming().c_str(),"boot_timing",millis());
         events.send(String(num_rtcm_uploads).c_str(),"num_uploads",millis());
+        events.send(String(num_clients).c_str(),"num_clients",millis());
+        events.send(clientTable().c_str(),"client_table",millis());
+        static unsigned long last_rate_update = 0;
+        rtcm_filter.updateRates((millis() - last_rate_update) / 1000.0);
+        rtcm_stats.updateRates((millis() - last_rate_update) / 1000.0);
+        caster_upload.updateRate((millis() - last_rate_update) / 1000.0);
+        rtcm_log.updateRate((millis() - last_rate_update) / 1000.0);
+        last_rate_update = millis();
+        events.send(filterTable().c_str(),"filter_table",millis());
+        events.send(uploadStatus().c_str(),"upload_status",millis());
+        events.send(coalesceStatus().c_str(),"coalesce",millis());
+        events.send(logStatus().c_str(),"rtcm_log",millis());
+        events.send(send_latency.summary().c_str(),"send_latency",millis());
+        events.send(survey_complete_string.c_str(),"survey",millis());
+        events.send(String(survey.meanSigma(), 4).c_str(),"survey_sigma",millis());
+        events.send(String(survey.num_samples).c_str(),"survey_samples",millis());
+        events.send(String(survey.timeToConverge(), 0).c_str(),"survey_eta",millis());
+        events.send(String(rtcm_framer.frames_failed).c_str(),"bad_frames",millis());
+        events.send(String(rtcm_framer.bytes_discarded).c_str(),"dropped_bytes",millis());
+        events.send(String(uart_overrun_bytes).c_str(),"uart_overruns",millis());
+        events.send(String(uart_ring.high_water).c_str(),"ring_high_water",millis());
 
         next_update = millis() + update_period;
 
     }
 }
+    
+// Install the ESP-IDF UART driver for the GNSS receiver and start the task
+// that moves received bytes into the ingest ring
+void startUartIngest()
+{
+
+    uart_config_t uart_config = {};
+    uart_config.baud_rate = 115200;
+    uart_config.data_bits = UART_DATA_8_BITS;
+    uart_config.parity = UART_PARITY_DISABLE;
+    uart_config.stop_bits = UART_STOP_BITS_1;
+    uart_config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uart_config.source_clk = UART_SCLK_APB;
 
-// Connect to WiFi
-void connectWiFi() 
+    uart_driver_install(GNSS_UART, GNSS_UART_BUFFER, 0, 20, &gnss_uart_queue, 0);
+    uart_param_config(GNSS_UART, &uart_config);
+    uart_set_pin(GNSS_UART, GNSS_TX_PIN, GNSS_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+    // Wake on a partly full FIFO or when the line goes idle at the end of a burst
+    uart_set_rx_full_threshold(GNSS_UART, GNSS_RX_FULL_THRESHOLD);
+    uart_set_rx_timeout(GNSS_UART, GNSS_RX_TIMEOUT);
+
+    // Runs above the Arduino loop task so UART data is moved promptly
+    xTaskCreate(uartIngestTask, "uart_ingest", 3072, NULL, configMAX_PRIORITIES - 2, NULL);
+}
+
+// Wait for UART events and copy received bytes straight into the ingest ring
+void uartIngestTask(void* parameter)
 {
 
-    int try_count = 0;
-    while ( WiFi.status() != WL_CONNECTED )
+    uart_event_t event;
+    for (;;)
     {
-        try_count++;
-        WiFi.disconnect();
-        WiFi.mode(WIFI_STA);
-        WiFi.begin( ssid, password );
-        if ( try_count == 10 )
+        if (!xQueueReceive(gnss_uart_queue, &event, portMAX_DELAY))
         {
-          ESP.restart();
+            continue;
         }
-        Serial.print('.');
-        delay(1000);
-        if(WiFi.status() == WL_CONNECTED)
+
+        if (event.type == UART_DATA)
         {
-            Serial.print(" IP Address: ");Serial.println(WiFi.localIP());
-            Serial.print("The MAC address for this board is: ");Serial.println(WiFi.macAddress());
+            size_t buffered = 0;
+            uart_get_buffered_data_len(GNSS_UART, &buffered);
+            while (buffered > 0)
+            {
+                uint32_t space = 0;
+                uint8_t* dest = uart_ring.writeBuffer(space);
+
+                // Ring full, discard the data so the UART keeps running
+                if (space == 0)
+                {
+                    uint8_t scratch[64];
+                    int dropped = uart_read_bytes(GNSS_UART, scratch, min(buffered, sizeof(scratch)), 0);
+                    if (dropped <= 0)
+                    {
+                        break;
+                    }
+                    uart_overrun_bytes += dropped;
+                    buffered -= dropped;
+                    continue;
+                }
+
+                int count = uart_read_bytes(GNSS_UART, dest, min((size_t)space, buffered), 0);
+                if (count <= 0)
+                {
+                    break;
+                }
+                uart_ring.commit(count, latencyClock());
+                buffered -= count;
+            }
+        }
+        else if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL)
+        {
+            // Driver lost data, restart from an empty buffer
+            size_t buffered = 0;
+            uart_get_buffered_data_len(GNSS_UART, &buffered);
+            uart_overrun_bytes += buffered;
+            uart_overrun_events++;
+            uart_flush_input(GNSS_UART);
+            xQueueReset(gnss_uart_queue);
         }
     }
 }
-    
-// Read serial buffer and pack data into an array for sending
-void readSerialBufferAndSend()
+
+// Read RTCM data from the ingest ring and store each frame for the clients
+// as soon as its last byte has arrived and the CRC has been checked
+void readSerialAndForward()
 {
-  
-    data_counter = 0;
-    data_available = false;
 
-    // Last time data was read
-    unsigned long last_read_time = 0;
+    uint8_t chunk[256];
+    uint32_t count;
+    uint32_t chunk_start = uart_ring.readPosition();
+    while ((count = uart_ring.read(chunk, sizeof(chunk))) > 0)
+    {
+        for (uint32_t n = 0; n < count; n++)
+        {
+            if (!rtcm_framer.addByte(chunk[n]))
+            {
+                continue;
+            }
+
+            const uint8_t* frame = rtcm_framer.frame();
+            uint16_t frame_length = rtcm_framer.frameLength();
+
+            // Time the last byte of the frame was read from the UART
+            uint32_t ingest_time = uart_ring.commitTime(chunk_start + n);
+
+            // Decode station position and MSM headers for survey monitoring
+            uint16_t message_type = rtcm_decoder.decode(frame, frame_length);
+            rtcm_stats.add(message_type, frame_length, ingest_time);
+
+            // Record every frame, the rate rules only apply to the rovers
+            if (message_type >= 1071 && message_type <= 1077)
+            {
+                gps_epoch_time = rtcm_decoder.epoch_time;
+            }
+            rtcm_log.add(frame, frame_length, gps_epoch_time);
+
+            // Last MSM of an epoch
+            bool msm = rtcmIsMSM(message_type);
+            bool end_of_epoch = msm && !rtcm_decoder.multiple_message;
+
+            // Store frame once for all TCP clients unless the rate rules drop it
+            if (rtcm_filter.allow(message_type, frame_length))
+            {
+                correction_ring.push(frame, frame_length, message_type, ingest_time, end_of_epoch);
+                num_rtcm_uploads += 1;
+
+                if (udp_enabled)
+                {
+                    sendUDPFrame(frame, frame_length, ingest_time);
+                }
+            }
+
+            // Keep every frame needed to warm start a new client
+            warm_start.add(frame, frame_length, message_type, msm, end_of_epoch);
+
+            if (end_of_epoch)
+            {
+                // Close the parity group so the epoch can be rebuilt right away
+                if (udp_enabled)
+                {
+                    sendUDPParity();
+                }
+                rtcm_filter.endOfEpoch();
+            }
+        }
+        chunk_start += count;
+    }
+}
+
+// Reply to clock requests with the base clock so rovers can line up their
+// latency measurements with the UART timestamps
+void serveTimeSync()
+{
 
-    // Read a burst of GNSS data, the PX11XX receivers send RTCM
-    // data in bursts of messages with hundreds of milliseconds
-    // between each burst
-    last_read_time = millis();
-    while (Serial1.available() || (millis() - last_read_time) < 50)
+    uint8_t data[TIME_SYNC_LENGTH];
+    while (time_sync_udp.parsePacket() > 0)
     {
-        if (Serial1.available() && data_counter<MAX_SERIAL_LENGTH)
+        int length = time_sync_udp.read(data, sizeof(data));
+        if (buildTimeSyncReply(data, length))
         {
-            // Read data from GNSS via serial
-            rtcm_data[data_counter] = Serial1.read();
-            data_counter++;
-            data_available = true;
-            last_read_time = millis();
+            if (latency_markers && (data[3] & TIME_SYNC_MARKERS))
+            {
+                requestMarkers(time_sync_udp.remoteIP());
+            }
+            time_sync_udp.beginPacket(time_sync_udp.remoteIP(), time_sync_udp.remotePort());
+            time_sync_udp.write(data, TIME_SYNC_LENGTH);
+            time_sync_udp.endPacket();
         }
     }
-    
-    // Send data to TCP server
-    if (data_available)
+}
+
+// Start latency messages for the raw TCP clients at a rover's address
+void requestMarkers(IPAddress address)
+{
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
     {
+        RoverClient& rover = rover_clients[i];
+        if (rover.active && rover.protocol == CLIENT_RAW && !rover.latency_markers &&
+            rover.client.remoteIP() == address)
+        {
+            rover.latency_markers = true;
+            Serial.print(millis());Serial.print(" Latency messages on for slot ");Serial.println(i);
+        }
+    }
+}
 
-        remote_client.write((uint8_t*)rtcm_data,data_counter);
-        Serial.print(millis());Serial.print(" Sent RTCM data length ");Serial.println(data_counter);
-        num_rtcm_uploads += 1;
-        data_length = data_counter;
-        data_counter = 0;
+// Answer discovery probes from rovers with a beacon and broadcast one every
+// DISCOVERY_PERIOD
+void serveDiscovery()
+{
+
+    uint8_t data[DISCOVERY_BEACON_LENGTH];
+    BaseBeacon beacon;
+    beacon.flags = survey_complete ? DISCOVERY_SURVEYED : 0;
+    beacon.clients = num_clients;
+    beacon.max_clients = MAX_CLIENTS;
+    beacon.tcp_port = COM_PORT;
+    beacon.ntrip_port = NTRIP_PORT;
+    beacon.udp_port = udp_enabled ? UDP_PORT : 0;
+    beacon.latitude = latitude * 1e7;
+    beacon.longitude = longitude * 1e7;
+    strncpy(beacon.name, base_hostname, DISCOVERY_NAME_LENGTH);
+    beacon.name[DISCOVERY_NAME_LENGTH] = '\0';
+
+    while (discovery_udp.parsePacket() > 0)
+    {
+        int length = discovery_udp.read(data, sizeof(data));
+        if (isProbe(data, length))
+        {
+            discovery_udp.beginPacket(discovery_udp.remoteIP(), discovery_udp.remotePort());
+            discovery_udp.write(data, packBeacon(data, beacon));
+            discovery_udp.endPacket();
+        }
     }
+
+    if (millis() < next_beacon)
+    {
+        return;
+    }
+    discovery_udp.beginPacket(IPAddress(255, 255, 255, 255), DISCOVERY_PORT);
+    discovery_udp.write(data, packBeacon(data, beacon));
+    discovery_udp.endPacket();
+    next_beacon = millis() + DISCOVERY_PERIOD;
+}
+
+// Send one frame to all rovers as a UDP datagram with a sequence header
+void sendUDPFrame(const uint8_t* frame, uint16_t frame_length, uint32_t ingest_time)
+{
+
+    UDPHeader header;
+    header.flags = 0;
+    header.sequence = udp_sequence++;
+    header.epoch = rtcm_filter.epoch;
+    header.fec_index = fecGroupSize() > 0 ? udp_parity.count : 0;
+    header.fec_count = 0;
+    header.timestamp = ingest_time;
+
+    uint8_t header_data[UDP_HEADER_LENGTH];
+    packUDPHeader(header_data, header);
+
+    correction_udp.beginPacket(udp_address, UDP_PORT);
+    correction_udp.write(header_data, UDP_HEADER_LENGTH);
+    correction_udp.write(frame, frame_length);
+    if (!correction_udp.endPacket())
+    {
+        udp_send_errors++;
+    }
+    else
+    {
+        wifi_supervisor.firstCorrection();
+    }
+
+    // Add the frame to the parity group, sent once the group is full
+    if (fecGroupSize() > 0)
+    {
+        udp_parity.add(header.sequence, frame, frame_length);
+        if (udp_parity.count >= fecGroupSize())
+        {
+            sendUDPParity();
+        }
+    }
+}
+
+// Send the parity datagram of the frames sent since the last one
+void sendUDPParity()
+{
+
+    if (udp_parity.count == 0)
+    {
+        return;
+    }
+
+    UDPHeader header;
+    header.flags = UDP_FLAG_PARITY;
+    header.sequence = udp_parity.first_sequence;
+    header.epoch = rtcm_filter.epoch;
+    header.fec_index = 0;
+    header.fec_count = udp_parity.count;
+    header.timestamp = latencyClock();
+
+    uint8_t header_data[UDP_HEADER_LENGTH];
+    packUDPHeader(header_data, header);
+
+    correction_udp.beginPacket(udp_address, UDP_PORT);
+    correction_udp.write(header_data, UDP_HEADER_LENGTH);
+    correction_udp.write(udp_parity.data(), udp_parity.length());
+    if (!correction_udp.endPacket())
+    {
+        udp_send_errors++;
+    }
+    udp_parity.reset();
+}
+
+// Frames per parity group, 0 when forward error correction is off
+uint8_t fecGroupSize()
+{
+
+    return udp_fec_group > UDP_MAX_FEC_GROUP ? UDP_MAX_FEC_GROUP : udp_fec_group;
 }
 
-// Check for client connection requests
+// Send frames stored in the correction ring to every connected client.
+// Writes never block, a client whose TCP window is full keeps its place in
+// the ring and is served again on the next loop.
+void sendToClients()
+{
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        RoverClient& rover = rover_clients[i];
+        if (!rover.active || !rover.streaming)
+        {
+            continue;
+        }
+
+        // Skip frames that were overwritten before they could be sent, a
+        // frame cut off part way can only be ended by closing the client
+        unsigned long missed = rover.cursor.frames_missed;
+        if (!correction_ring.catchUp(rover.cursor))
+        {
+            Serial.print(millis());Serial.print(" Closing client in slot ");Serial.print(i);
+            Serial.println(", partly sent frame overwritten");
+            rover.client.stop();
+            continue;
+        }
+
+        // A client is behind while it keeps losing frames, to overwrites or
+        // to the backlog bound, until it goes CLIENT_RECOVER_TIME without a
+        // loss
+        bool over_backlog = correction_ring.pending(rover.cursor) > MAX_CLIENT_BACKLOG;
+        if (over_backlog || rover.cursor.frames_missed != missed)
+        {
+            rover.last_loss = millis();
+            if (rover.behind_since == 0)
+            {
+                rover.behind_since = millis();
+            }
+        }
+        else if (rover.behind_since != 0 && millis() - rover.last_loss > CLIENT_RECOVER_TIME)
+        {
+            rover.behind_since = 0;
+        }
+
+        // Disconnect clients that stay behind too long
+        if (rover.behind_since != 0 && millis() - rover.behind_since > CLIENT_EVICT_TIME)
+        {
+            Serial.print(millis());Serial.print(" Evicting slow client in slot ");Serial.println(i);
+            rover.client.stop();
+            continue;
+        }
+
+        // Bound the backlog by dropping the oldest whole frames
+        if (over_backlog)
+        {
+            correction_ring.trim(rover.cursor, MAX_CLIENT_BACKLOG);
+        }
+
+        // Finish the warm start snapshot before any live frames, a client
+        // that cannot take it in time is closed so that it does not keep
+        // the snapshot from being refreshed
+        if (rover.warm_start && !sendWarmStart(rover))
+        {
+            if (millis() - rover.warm_start_time > WARM_START_TIMEOUT)
+            {
+                Serial.print(millis());Serial.print(" Closing client in slot ");Serial.print(i);
+                Serial.println(", warm start timed out");
+                rover.client.stop();
+            }
+            continue;
+        }
+
+        // Start from the first frame of the next epoch
+        if (rover.wait_for_epoch)
+        {
+            if ((int32_t)(correction_ring.epochFrame() - rover.cursor.frame) <= 0)
+            {
+                continue;
+            }
+            correction_ring.attachAt(rover.cursor, correction_ring.epochFrame());
+            rover.wait_for_epoch = false;
+        }
+
+        // The latency message of the last epoch goes out before more frames
+        if (!sendMarker(rover))
+        {
+            continue;
+        }
+
+        // Send the completed epoch, or everything once frames waited too long
+        uint32_t ready = coalescedLength(rover.cursor);
+        uint32_t length = 0;
+        const uint8_t* data;
+        while (ready > 0 && (data = correction_ring.peek(rover.cursor, length)) != NULL)
+        {
+            if (length > ready)
+            {
+                length = ready;
+            }
+
+            // Stop at the end of an epoch to follow it with its latency
+            // message
+            if (rover.latency_markers)
+            {
+                length = bytesToEpochEnd(rover.cursor, length);
+            }
+            uint32_t hold = latencyClock() - correction_ring.frame(rover.cursor.frame).time;
+            uint32_t first_frame = rover.cursor.frame;
+
+            int sent = sendPayload(rover, data, length);
+            if (sent <= 0)
+            {
+                break;
+            }
+            correction_ring.advance(rover.cursor, sent);
+            ready -= sent;
+
+            coalesce_writes++;
+            coalesce_frames += rover.cursor.frame - first_frame;
+            coalesce_hold_total += hold;
+            if (hold > coalesce_hold_max)
+            {
+                coalesce_hold_max = hold;
+            }
+            send_latency.add(hold);
+
+            // Stamp the epoch that has just been sent
+            if (rover.latency_markers && rover.cursor.offset == 0 && rover.cursor.frame != first_frame)
+            {
+                const RingFrame& last = correction_ring.frame(rover.cursor.frame - 1);
+                if (last.epoch_end)
+                {
+                    rover.marker_length = buildLatencyFrame(rover.marker, last.time);
+                    rover.marker_sent = 0;
+                    if (!sendMarker(rover))
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if ((uint32_t)sent < length)
+            {
+                break;
+            }
+        }
+    }
+}
+
+// Bytes from a cursor to the end of the next frame that ends an epoch, at
+// most length
+uint32_t bytesToEpochEnd(const RingCursor& cursor, uint32_t length)
+{
+
+    uint32_t bytes = 0;
+    for (uint32_t sequence = cursor.frame; sequence != correction_ring.headFrame() && bytes < length; sequence++)
+    {
+        const RingFrame& frame = correction_ring.frame(sequence);
+        bytes += frame.length - (sequence == cursor.frame ? cursor.offset : 0);
+        if (frame.epoch_end)
+        {
+            break;
+        }
+    }
+    return bytes < length ? bytes : length;
+}
+
+// Send the rest of a client's latency message, returns true once all of it
+// has been sent
+bool sendMarker(RoverClient& rover)
+{
+
+    while (rover.marker_sent < rover.marker_length)
+    {
+        int sent = sendPayload(rover, rover.marker + rover.marker_sent,
+                               rover.marker_length - rover.marker_sent);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        rover.marker_sent += sent;
+    }
+    return true;
+}
+
+// Bytes a cursor may send now: frames up to the end of the last completed
+// epoch, or every stored frame once the oldest unsent one has waited
+// COALESCE_MAX_DELAY
+uint32_t coalescedLength(const RingCursor& cursor)
+{
+
+    uint32_t pending = correction_ring.pending(cursor);
+    if (pending == 0)
+    {
+        return 0;
+    }
+    if (latencyClock() - correction_ring.frame(cursor.frame).time >= COALESCE_MAX_DELAY * 1000UL)
+    {
+        return pending;
+    }
+    return correction_ring.pendingBefore(cursor, correction_ring.epochFrame());
+}
+
+// Send the rest of the warm start snapshot without blocking, returns true
+// once the whole snapshot has been sent
+bool sendWarmStart(RoverClient& rover)
+{
+
+    uint16_t length = warm_start.length(rover.warm_snapshot);
+    while (rover.warm_offset < length)
+    {
+        int sent = sendPayload(rover, warm_start.data(rover.warm_snapshot) + rover.warm_offset,
+                               length - rover.warm_offset);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        rover.warm_offset += sent;
+    }
+
+    rover.warm_start = false;
+    warm_start.release(rover.warm_snapshot);
+    return true;
+}
+
+// Write correction data to a client without blocking, adding chunk framing
+// for NTRIP v2 clients. Returns the number of data bytes sent, 0 if the
+// socket cannot take more right now and -1 if the client failed.
+int sendPayload(RoverClient& rover, const uint8_t* data, uint32_t length)
+{
+
+    if (rover.protocol == CLIENT_NTRIP_V2)
+    {
+        // Start a new chunk holding the data offered now
+        if (rover.chunk_remaining == 0 && rover.prefix_sent == rover.prefix_length)
+        {
+            rover.prefix_length = ntripChunkHeader(rover.chunk_prefix, length, rover.chunk_open);
+            rover.prefix_sent = 0;
+            rover.chunk_remaining = length;
+            rover.chunk_open = true;
+        }
+
+        // Chunk framing goes out before the data it describes
+        while (rover.prefix_sent < rover.prefix_length)
+        {
+            int sent = socketSend(rover, (const uint8_t*)rover.chunk_prefix + rover.prefix_sent,
+                                  rover.prefix_length - rover.prefix_sent);
+            if (sent <= 0)
+            {
+                return sent;
+            }
+            rover.prefix_sent += sent;
+        }
+
+        if (length > rover.chunk_remaining)
+        {
+            length = rover.chunk_remaining;
+        }
+    }
+
+    int sent = socketSend(rover, data, length);
+    if (sent > 0)
+    {
+        wifi_supervisor.firstCorrection();
+        rover.bytes_sent += sent;
+        if (rover.protocol == CLIENT_NTRIP_V2)
+        {
+            rover.chunk_remaining -= sent;
+        }
+    }
+    return sent;
+}
+
+// Non-blocking write to a client socket, returns the number of bytes sent,
+// 0 if the send buffer is full and -1 after closing a failed client
+int socketSend(RoverClient& rover, const uint8_t* data, uint32_t length)
+{
+
+    int sent = send(rover.client.fd(), data, length, MSG_DONTWAIT);
+    if (sent < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+
+        // Socket error other than a full send buffer
+        Serial.print(millis());Serial.println(" Send to client failed");
+        rover.client.stop();
+        return -1;
+    }
+    return sent;
+}
+
+// Per client backlog and drop counters for the RTK page
+String clientTable()
+{
+
+    String table = "";
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        RoverClient& rover = rover_clients[i];
+        if (!rover.active)
+        {
+            continue;
+        }
+        table += rover.client.remoteIP().toString() + " " + clientProtocol(rover) + ": ";
+        if (!rover.streaming)
+        {
+            table += "waiting for request<br>";
+            continue;
+        }
+        table += String(correction_ring.pending(rover.cursor)) + " B backlog, ";
+        table += String(rover.cursor.frames_dropped + rover.cursor.frames_missed) + " dropped<br>";
+    }
+    if (table.length() == 0)
+    {
+        table = "None";
+    }
+    return table;
+}
+
+// Send frames stored in the correction ring to the external caster without
+// blocking, the upload starts from the newest frame each time it connects
+void sendToCaster()
+{
+
+    bool was_streaming = caster_upload.streaming();
+    if (!caster_upload.service())
+    {
+        return;
+    }
+    if (!was_streaming)
+    {
+        correction_ring.attach(upload_cursor);
+    }
+
+    // Skip overwritten frames and bound the backlog by dropping whole frames
+    if (!correction_ring.catchUp(upload_cursor))
+    {
+        caster_upload.restart("Upload closed, partly sent frame overwritten");
+        return;
+    }
+    correction_ring.trim(upload_cursor, MAX_UPLOAD_BACKLOG);
+
+    uint32_t ready = coalescedLength(upload_cursor);
+    uint32_t length = 0;
+    const uint8_t* data;
+    while (ready > 0 && (data = correction_ring.peek(upload_cursor, length)) != NULL)
+    {
+        if (length > ready)
+        {
+            length = ready;
+        }
+        int sent = caster_upload.write(data, length);
+        if (sent <= 0)
+        {
+            break;
+        }
+        correction_ring.advance(upload_cursor, sent);
+        ready -= sent;
+        if ((uint32_t)sent < length)
+        {
+            break;
+        }
+    }
+}
+
+// Frames per client write and mean / max hold time for the RTK page
+String coalesceStatus()
+{
+
+    if (coalesce_writes == 0)
+    {
+        return "None";
+    }
+    return String((float)coalesce_frames / coalesce_writes, 2) + " frames, " +
+           String(coalesce_hold_total / coalesce_writes / 1000.0, 1) + " / " +
+           String(coalesce_hold_max / 1000.0, 1) + " ms";
+}
+
+// Flash write rate, page write time, cost of logging in the forwarding path
+// and dropped frames for the RTK page
+String logStatus()
+{
+
+    if (!rtcm_log.running)
+    {
+        return "Off";
+    }
+
+    String status = String(rtcm_log.write_rate, 0) + " B/s, write ";
+    if (rtcm_log.pages_written > 0)
+    {
+        status += String(rtcm_log.write_time_total / rtcm_log.pages_written / 1000.0, 1) + " / ";
+    }
+    status += String(rtcm_log.write_time_max / 1000.0, 1) + " ms, add ";
+    if (rtcm_log.frames_logged > 0)
+    {
+        status += String((float)rtcm_log.add_time_total / rtcm_log.frames_logged, 1) + " / ";
+    }
+    status += String(rtcm_log.add_time_max) + " us, ";
+    status += String(rtcm_log.frames_dropped) + " dropped";
+    return status;
+}
+
+// Caster upload state, rate and backlog for the RTK page
+String uploadStatus()
+{
+
+    if (!ntrip_upload_enabled)
+    {
+        return "Off";
+    }
+
+    String status = String(caster_upload.status()) + ": " + String(caster_upload.rate, 0) + " B/s";
+    if (caster_upload.streaming())
+    {
+        status += ", " + String(correction_ring.pending(upload_cursor)) + " B backlog, ";
+        status += String(upload_cursor.frames_dropped + upload_cursor.frames_missed) + " dropped";
+    }
+    else
+    {
+        status += ", " + String(caster_upload.failures) + " failures";
+    }
+    return status;
+}
+
+// Name of the protocol a client uses
+String clientProtocol(RoverClient& rover)
+{
+
+    switch (rover.protocol)
+    {
+        case CLIENT_NTRIP_REQUEST: return "NTRIP";
+        case CLIENT_NTRIP_V1: return "NTRIP v1";
+        case CLIENT_NTRIP_V2: return "NTRIP v2";
+        default: return "TCP";
+    }
+}
+
+// Forwarded byte rate per filtered message type for the RTK page
+String filterTable()
+{
+
+    String table = "";
+    for (unsigned int i = 0; i < NUM_RTCM_RULES; i++)
+    {
+        RTCMRule& rule = rtcm_rules[i];
+        table += String(rule.message_type) + ": " + String(rule.rate_out, 0) + " / ";
+        table += String(rule.rate_in, 0) + " B/s<br>";
+    }
+    table += "All: " + String(rtcm_filter.rate_out, 0) + " / " + String(rtcm_filter.rate_in, 0) + " B/s";
+    table += " (" + String(rtcm_filter.reduction(), 1) + "&percnt; saved)";
+    return table;
+}
+
+// Check for client connection requests and release disconnected clients
 void checkForConnections()
 {
 
-    if (!remote_client || !remote_client.connected()) 
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        RoverClient& rover = rover_clients[i];
+        if (rover.active && !rover.client.connected())
+        {
+            Serial.print(millis());Serial.print(" Client disconnected from slot ");Serial.println(i);
+            rover.client.stop();
+            rover.active = false;
+            if (rover.warm_start)
+            {
+                rover.warm_start = false;
+                warm_start.release(rover.warm_snapshot);
+            }
+            num_clients--;
+        }
+    }
+
+    // Check if a raw or NTRIP client has connected
+    WiFiClient new_client = tcp_server.available();
+    if (new_client)
+    {
+        addClient(new_client, CLIENT_RAW);
+    }
+
+    new_client = ntrip_server.available();
+    if (new_client)
+    {
+        addClient(new_client, CLIENT_NTRIP_REQUEST);
+    }
+}
+
+// Put a new client in a free slot, raw clients start streaming right away
+// while NTRIP clients first send their request
+void addClient(WiFiClient& new_client, uint8_t protocol)
+{
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
     {
-        // Check if a client has connected
-        remote_client = tcp_server.available();
-        if (remote_client) 
+        RoverClient& rover = rover_clients[i];
+        if (!rover.active)
         {
-          Serial.print(millis());Serial.println( "New client connected");
+            rover.client = new_client;
+            // Each coalesced epoch should leave in its own segment right away
+            rover.client.setNoDelay(true);
+            rover.active = true;
+            rover.protocol = protocol;
+            rover.connect_time = millis();
+            rover.streaming = false;
+            rover.warm_start = false;
+            rover.bytes_sent = 0;
+            rover.behind_since = 0;
+            rover.last_loss = 0;
+            rover.latency_markers = false;
+            rover.marker_length = 0;
+            rover.marker_sent = 0;
+            rover.request_length = 0;
+            rover.prefix_length = 0;
+            rover.prefix_sent = 0;
+            rover.chunk_remaining = 0;
+            rover.chunk_open = false;
+            num_clients++;
+            Serial.print(millis());Serial.print(" New client connected in slot ");Serial.println(i);
+
+            if (protocol == CLIENT_RAW)
+            {
+                startStreaming(rover);
+            }
+            return;
         }
     }
+
+    Serial.print(millis());Serial.println(" Client refused, all slots in use");
+    new_client.stop();
+}
+
+// Start sending corrections to a client
+void startStreaming(RoverClient& rover)
+{
+
+    rover.streaming = true;
+
+    // Live frames follow on from the end of the snapshot, which is the last
+    // completed epoch. If those frames are gone the rest of the current
+    // epoch is skipped.
+    rover.wait_for_epoch = !correction_ring.attachAt(rover.cursor, correction_ring.epochFrame());
+    if (rover.wait_for_epoch)
+    {
+        correction_ring.attach(rover.cursor);
+    }
+
+    // Replay cached station messages and the last epoch right away
+    rover.warm_start = true;
+    rover.warm_offset = 0;
+    rover.warm_start_time = millis();
+    rover.warm_snapshot = warm_start.acquire();
+    sendWarmStart(rover);
+}
+
+// Read NTRIP requests from new caster clients and answer them with the
+// sourcetable or the start of a correction stream
+void serveNtripRequests()
+{
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        RoverClient& rover = rover_clients[i];
+        if (!rover.active || rover.protocol != CLIENT_NTRIP_REQUEST)
+        {
+            continue;
+        }
+
+        while (rover.client.available() && rover.request_length < NTRIP_MAX_REQUEST)
+        {
+            rover.request[rover.request_length++] = rover.client.read();
+        }
+        rover.request[rover.request_length] = '\0';
+
+        if (!ntripRequestComplete(rover.request))
+        {
+            if (rover.request_length >= NTRIP_MAX_REQUEST ||
+                millis() - rover.connect_time > NTRIP_REQUEST_TIMEOUT)
+            {
+                rover.client.print(ntrip_bad_request);
+                rover.client.stop();
+            }
+            continue;
+        }
+
+        char mountpoint[32];
+        bool v2 = false;
+        if (!parseNtripRequest(rover.request, mountpoint, sizeof(mountpoint), v2))
+        {
+            rover.client.print(ntrip_bad_request);
+            rover.client.stop();
+            continue;
+        }
+
+        Serial.print(millis());Serial.print(" NTRIP request for /");Serial.print(mountpoint);
+        Serial.println(v2 ? " (v2)" : " (v1)");
+
+        if (findNtripMountpoint(mountpoint) < 0)
+        {
+            // Sourcetable for requests without a known mountpoint, v2 clients
+            // asking for an unknown mountpoint get not found
+            if (v2 && mountpoint[0] != '\0')
+            {
+                rover.client.print(ntrip_v2_not_found);
+            }
+            else
+            {
+                rover.client.print(ntripSourcetable(v2, latitude, longitude));
+            }
+            rover.client.stop();
+            continue;
+        }
+
+        rover.client.print(v2 ? ntrip_v2_ok : ntrip_v1_ok);
+        rover.protocol = v2 ? CLIENT_NTRIP_V2 : CLIENT_NTRIP_V1;
+        startStreaming(rover);
+    }
 }
 
 // Populates initial webpage values on first load
@@ -438,6 +1549,14 @@ String initTinkerCharge(const String& var)
 String initRTK(const String& var)
 {
 
+    if(var == "BOOT_TIMING")
+    {
+      return wifi_supervisor.bootTiming();
+    }
+    if(var == "WIFI_STATUS")
+    {
+      return wifi_supervisor.status();
+    }
     if(var == "UP_TIME")
     {
       return String(millis()/1000.0/60);
@@ -446,10 +1565,66 @@ String initRTK(const String& var)
     {
       return String(num_rtcm_uploads);
     }
-        if(var == "SURV_STRING")
+    else if(var == "NUM_CLIENTS")
+    {
+      return String(num_clients);
+    }
+    else if(var == "CLIENT_TABLE")
+    {
+      return clientTable();
+    }
+    else if(var == "UART_OVERRUNS")
+    {
+      return String(uart_overrun_bytes);
+    }
+    else if(var == "RING_HIGH_WATER")
+    {
+      return String(uart_ring.high_water);
+    }
+    else if(var == "SEND_LATENCY")
+    {
+      return send_latency.summary();
+    }
+    else if(var == "RTCM_LOG")
+    {
+      return logStatus();
+    }
+    else if(var == "COALESCE")
+    {
+      return coalesceStatus();
+    }
+    else if(var == "UPLOAD_STATUS")
+    {
+      return uploadStatus();
+    }
+    else if(var == "FILTER_TABLE")
+    {
+      return filterTable();
+    }
+    else if(var == "BAD_FRAMES")
+    {
+      return String(rtcm_framer.frames_failed);
+    }
+    else if(var == "DROPPED_BYTES")
+    {
+      return String(rtcm_framer.bytes_discarded);
+    }
+    else if(var == "SURV_STRING")
     {
       return survey_complete_string;
     }
+    else if(var == "SURV_SIGMA")
+    {
+      return String(survey.meanSigma(), 4);
+    }
+    else if(var == "SURV_SAMPLES")
+    {
+      return String(survey.num_samples);
+    }
+    else if(var == "SURV_ETA")
+    {
+      return String(survey.timeToConverge(), 0);
+    }
 
     return String();
 }
@@ -0,0 +1,221 @@
+/** Correction Ring Buffer
+ *  Shared store of validated RTCM frames. Each frame is written once and every
+ *  connected client reads it through its own cursor, so the data for a burst is
+ *  never copied per client. When the buffer is full the oldest frames are
+ *  overwritten and clients still pointing at them are moved forward, or
+ *  closed if they were part way through sending one.
+ *  Positions are free running counters, the buffer index is the position
+ *  masked by the (power of two) buffer size. Frames carry their UART time
+ *  and the last MSM frame of an epoch is marked so that clients can send a
+ *  whole epoch in one write.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef CORRECTION_RING_H
+#define CORRECTION_RING_H
+
+// Size of the shared frame data buffer (bytes, power of two)
+#define RING_DATA_SIZE 16384
+
+// Max number of frames held in the buffer (power of two)
+#define RING_MAX_FRAMES 256
+
+// Location of one frame in the data buffer
+struct RingFrame
+{
+    uint32_t start;
+    uint16_t length;
+    uint16_t message_type;
+    // Base clock (us, see latency.h) when the frame was read from the UART
+    uint32_t time;
+    // Last frame of an MSM epoch
+    bool epoch_end;
+};
+
+// Read position of a single client
+struct RingCursor
+{
+    // Sequence number of the frame being sent
+    uint32_t frame;
+    // Bytes of that frame already sent
+    uint16_t offset;
+    // Frames overwritten before the client could send them
+    unsigned long frames_missed;
+    // Frames skipped to keep the client backlog bounded
+    unsigned long frames_dropped;
+};
+
+class CorrectionRing
+{
+  public:
+
+    // Store a complete frame, dropping the oldest frames to make room
+    void push(const uint8_t* data, uint16_t length, uint16_t message_type,
+              uint32_t time, bool epoch_end)
+    {
+        if (length == 0 || length > RING_DATA_SIZE)
+            return;
+
+        while (tail_frame != head_frame &&
+               (head_frame - tail_frame >= RING_MAX_FRAMES ||
+                head_pos + length - frames[tail_frame % RING_MAX_FRAMES].start > RING_DATA_SIZE))
+        {
+            tail_frame++;
+        }
+
+        // Copy in up to two pieces around the end of the buffer
+        uint32_t index = head_pos % RING_DATA_SIZE;
+        uint32_t first = RING_DATA_SIZE - index;
+        if (first > length)
+            first = length;
+        memcpy(buffer + index, data, first);
+        memcpy(buffer, data + first, length - first);
+
+        RingFrame& frame = frames[head_frame % RING_MAX_FRAMES];
+        frame.start = head_pos;
+        frame.length = length;
+        frame.message_type = message_type;
+        frame.time = time;
+        frame.epoch_end = epoch_end;
+
+        head_pos += length;
+        head_frame++;
+        if (epoch_end)
+            epoch_frame = head_frame;
+
+        bytes_stored += length;
+    }
+
+    // Start a cursor at the next frame to be stored
+    void attach(RingCursor& cursor) const
+    {
+        cursor.frame = head_frame;
+        cursor.offset = 0;
+        cursor.frames_missed = 0;
+        cursor.frames_dropped = 0;
+    }
+
+    // Start a cursor at a stored frame or at the next frame to be stored.
+    // Returns false and leaves the cursor alone if the frame has been
+    // overwritten.
+    bool attachAt(RingCursor& cursor, uint32_t frame) const
+    {
+        if ((int32_t)(frame - tail_frame) < 0 || (int32_t)(head_frame - frame) < 0)
+            return false;
+
+        attach(cursor);
+        cursor.frame = frame;
+        return true;
+    }
+
+    // Move a cursor whose frames were overwritten to the oldest stored
+    // frame. Returns false if the frame it was part way through was
+    // overwritten, the rest of that frame is lost and the client has to be
+    // closed rather than sent a broken frame.
+    bool catchUp(RingCursor& cursor) const
+    {
+        if ((int32_t)(cursor.frame - tail_frame) >= 0)
+            return true;
+
+        bool whole = cursor.offset == 0;
+        cursor.frames_missed += tail_frame - cursor.frame;
+        cursor.frame = tail_frame;
+        cursor.offset = 0;
+        return whole;
+    }
+
+    // Skip whole unsent frames, oldest first, until the cursor has no more
+    // than max_pending bytes left. A partly sent frame is always completed
+    // first so that the client never receives a broken frame, frames after
+    // it are trimmed once it has been sent.
+    void trim(RingCursor& cursor, uint32_t max_pending) const
+    {
+        while (cursor.offset == 0 && pending(cursor) > max_pending)
+        {
+            cursor.frame++;
+            cursor.frames_dropped++;
+        }
+    }
+
+    // Number of bytes a cursor still has to send
+    uint32_t pending(const RingCursor& cursor) const
+    {
+        if (cursor.frame == head_frame)
+            return 0;
+        return head_pos - frames[cursor.frame % RING_MAX_FRAMES].start - cursor.offset;
+    }
+
+    // Number of bytes a cursor has to send before reaching frame end_frame
+    uint32_t pendingBefore(const RingCursor& cursor, uint32_t end_frame) const
+    {
+        if ((int32_t)(end_frame - cursor.frame) <= 0)
+            return 0;
+        if (end_frame == head_frame)
+            return pending(cursor);
+        return frames[end_frame % RING_MAX_FRAMES].start - frames[cursor.frame % RING_MAX_FRAMES].start - cursor.offset;
+    }
+
+    // Pointer to the next unsent bytes of a cursor and the number of bytes
+    // that can be read from it without wrapping around the end of the buffer
+    const uint8_t* peek(const RingCursor& cursor, uint32_t& length) const
+    {
+        length = pending(cursor);
+        if (length == 0)
+            return NULL;
+
+        uint32_t index = (frames[cursor.frame % RING_MAX_FRAMES].start + cursor.offset) % RING_DATA_SIZE;
+        if (length > RING_DATA_SIZE - index)
+            length = RING_DATA_SIZE - index;
+        return buffer + index;
+    }
+
+    // Mark bytes as sent, stepping the cursor over completed frames
+    void advance(RingCursor& cursor, uint32_t length) const
+    {
+        while (length > 0 && cursor.frame != head_frame)
+        {
+            uint16_t remaining = frames[cursor.frame % RING_MAX_FRAMES].length - cursor.offset;
+            if (length < remaining)
+            {
+                cursor.offset += length;
+                return;
+            }
+            length -= remaining;
+            cursor.frame++;
+            cursor.offset = 0;
+        }
+    }
+
+    // Frame details by sequence number
+    const RingFrame& frame(uint32_t sequence) const
+    {
+        return frames[sequence % RING_MAX_FRAMES];
+    }
+
+    uint32_t headFrame() const { return head_frame; }
+
+    // Frame following the last completed epoch
+    uint32_t epochFrame() const { return epoch_frame; }
+    uint32_t tailFrame() const { return tail_frame; }
+
+    // Total bytes stored since startup
+    unsigned long bytes_stored = 0;
+
+  private:
+
+    uint8_t buffer[RING_DATA_SIZE];
+    RingFrame frames[RING_MAX_FRAMES];
+
+    // Next byte position and frame sequence number to be written
+    uint32_t head_pos = 0;
+    uint32_t head_frame = 0;
+
+    // Oldest frame still held in the buffer
+    uint32_t tail_frame = 0;
+
+    // Frame following the last frame marked as the end of an epoch
+    uint32_t epoch_frame = 0;
+};
+
+#endif
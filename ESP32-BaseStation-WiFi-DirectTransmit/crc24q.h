@@ -0,0 +1,73 @@
+/** CRC-24Q
+ *  Table driven CRC-24Q (polynomial 0x1864CFB) used to validate RTCM3 frames.
+ *  The CRC is kept left aligned in a 32 bit register so that four input bytes
+ *  are folded in per step using four 256 entry lookup tables (slicing-by-4).
+ *  crc24qInit() must be called once at startup to fill the tables.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef CRC24Q_H
+#define CRC24Q_H
+
+// Polynomial without the x^24 term, left aligned in 32 bits
+#define CRC24Q_POLY 0x864CFB00UL
+
+// Lookup tables, crc24q_table[k][i] is the CRC contribution of byte i
+// followed by k zero bytes
+uint32_t crc24q_table[4][256];
+
+// Fill lookup tables
+void crc24qInit()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint32_t crc = (uint32_t)i << 24;
+        for (int j = 0; j < 8; j++)
+        {
+            if (crc & 0x80000000UL)
+                crc = (crc << 1) ^ CRC24Q_POLY;
+            else
+                crc <<= 1;
+        }
+        crc24q_table[0][i] = crc;
+    }
+
+    for (int k = 1; k < 4; k++)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint32_t prev = crc24q_table[k-1][i];
+            crc24q_table[k][i] = (prev << 8) ^ crc24q_table[0][prev >> 24];
+        }
+    }
+}
+
+// Compute the CRC-24Q of a data block
+uint32_t crc24q(const uint8_t* data, uint16_t length)
+{
+    uint32_t crc = 0;
+
+    // Four bytes per step
+    while (length >= 4)
+    {
+        crc ^= ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+               ((uint32_t)data[2] << 8) | data[3];
+        crc = crc24q_table[3][crc >> 24] ^
+              crc24q_table[2][(crc >> 16) & 0xFF] ^
+              crc24q_table[1][(crc >> 8) & 0xFF] ^
+              crc24q_table[0][crc & 0xFF];
+        data += 4;
+        length -= 4;
+    }
+
+    // Remaining bytes one at a time
+    while (length--)
+    {
+        crc = (crc << 8) ^ crc24q_table[0][(crc >> 24) ^ *data++];
+    }
+
+    return crc >> 8;
+}
+
+#endif
@@ -0,0 +1,128 @@
+/** Base Station Discovery
+ *  Small UDP beacon that lets rovers find the base station without a fixed
+ *  address. The base broadcasts a beacon on DISCOVERY_PORT every
+ *  DISCOVERY_PERIOD and answers a rover's probe straight away, so a rover
+ *  that probes at startup or after losing its link has the base address
+ *  within one round trip. The beacon carries the base station's name, the
+ *  correction ports, the base position and how many client slots are in
+ *  use. Rovers only follow beacons with the name they expect, so several
+ *  base stations can share a network.
+ *  Beacon layout (little endian):
+ *    'T' 'R' 'B' version, flags (bit 0 survey complete), clients,
+ *    max clients, reserved, TCP port, NTRIP port, UDP port, reserved,
+ *    latitude and longitude (1e-7 deg), name (DISCOVERY_NAME_LENGTH bytes,
+ *    zero padded)
+ *  Probe: 'T' 'R' 'Q' version
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#define DISCOVERY_PORT 4084
+#define DISCOVERY_VERSION 2
+#define DISCOVERY_NAME_LENGTH 32
+#define DISCOVERY_BEACON_LENGTH (24 + DISCOVERY_NAME_LENGTH)
+#define DISCOVERY_PROBE_LENGTH 4
+
+// Time between base beacons (ms)
+#define DISCOVERY_PERIOD 1000
+
+// Time between rover probes while the base is not connected (ms)
+#define DISCOVERY_PROBE_PERIOD 250
+
+#define DISCOVERY_SURVEYED 0x01
+
+struct BaseBeacon
+{
+    uint8_t flags;
+    uint8_t clients;
+    uint8_t max_clients;
+    uint16_t tcp_port;
+    uint16_t ntrip_port;
+    uint16_t udp_port;
+    int32_t latitude;
+    int32_t longitude;
+    char name[DISCOVERY_NAME_LENGTH + 1];
+};
+
+void packDiscovery16(uint8_t* data, uint16_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+}
+
+void packDiscovery32(uint8_t* data, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        data[i] = value >> (8 * i);
+}
+
+uint16_t unpackDiscovery16(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t unpackDiscovery32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Write a beacon, returns its length
+int packBeacon(uint8_t* data, const BaseBeacon& beacon)
+{
+    memset(data, 0, DISCOVERY_BEACON_LENGTH);
+    data[0] = 'T';
+    data[1] = 'R';
+    data[2] = 'B';
+    data[3] = DISCOVERY_VERSION;
+    data[4] = beacon.flags;
+    data[5] = beacon.clients;
+    data[6] = beacon.max_clients;
+    packDiscovery16(data + 8, beacon.tcp_port);
+    packDiscovery16(data + 10, beacon.ntrip_port);
+    packDiscovery16(data + 12, beacon.udp_port);
+    packDiscovery32(data + 16, beacon.latitude);
+    packDiscovery32(data + 20, beacon.longitude);
+    strncpy((char*)data + 24, beacon.name, DISCOVERY_NAME_LENGTH);
+    return DISCOVERY_BEACON_LENGTH;
+}
+
+// Read a beacon, returns false if the datagram is not a beacon
+bool unpackBeacon(const uint8_t* data, int length, BaseBeacon& beacon)
+{
+    if (length < DISCOVERY_BEACON_LENGTH || data[0] != 'T' || data[1] != 'R' ||
+        data[2] != 'B' || data[3] != DISCOVERY_VERSION)
+        return false;
+
+    beacon.flags = data[4];
+    beacon.clients = data[5];
+    beacon.max_clients = data[6];
+    beacon.tcp_port = unpackDiscovery16(data + 8);
+    beacon.ntrip_port = unpackDiscovery16(data + 10);
+    beacon.udp_port = unpackDiscovery16(data + 12);
+    beacon.latitude = unpackDiscovery32(data + 16);
+    beacon.longitude = unpackDiscovery32(data + 20);
+    memcpy(beacon.name, data + 24, DISCOVERY_NAME_LENGTH);
+    beacon.name[DISCOVERY_NAME_LENGTH] = '\0';
+    return true;
+}
+
+// Write a rover probe, returns its length
+int packProbe(uint8_t* data)
+{
+    data[0] = 'T';
+    data[1] = 'R';
+    data[2] = 'Q';
+    data[3] = DISCOVERY_VERSION;
+    return DISCOVERY_PROBE_LENGTH;
+}
+
+bool isProbe(const uint8_t* data, int length)
+{
+    return length >= DISCOVERY_PROBE_LENGTH && data[0] == 'T' && data[1] == 'R' &&
+           data[2] == 'Q' && data[3] == DISCOVERY_VERSION;
+}
+
+#endif
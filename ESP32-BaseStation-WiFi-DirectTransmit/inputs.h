@@ -1,3 +1,63 @@
 // Replace with your network credentials
 const char* ssid = "XXXXX";
 const char* password = "XXXXXX";
+
+// Longest WiFi outage before the ESP32 restarts (s), 0 never restarts. The
+// correction pipeline keeps running and reconnects in the background until
+// then.
+const unsigned long wifi_restart_grace = 300;
+
+// Connect straight to the last access point (BSSID and channel saved in
+// flash) instead of scanning first. wifi_reuse_lease also reuses the last
+// DHCP address without asking the server again, only use it when the router
+// keeps the address reserved for this board.
+const bool wifi_fast_connect = true;
+const bool wifi_reuse_lease = false;
+
+// Optional static address, skips DHCP on boot and after every dropout
+const bool wifi_static_ip = false;
+IPAddress wifi_ip(192, 168, 86, 35);
+IPAddress wifi_gateway(192, 168, 86, 1);
+IPAddress wifi_subnet(255, 255, 255, 0);
+IPAddress wifi_dns(192, 168, 86, 1);
+
+// Name announced by mDNS (<name>.local) and DNS-SD (_rtcm._tcp, _ntrip._tcp)
+// and in the UDP beacon, rovers only follow the beacon of the base station
+// named in their base_name
+const char* base_hostname = "tinkerrtk-base";
+
+// Optional UDP correction transport. When enabled each RTCM frame is also sent
+// once to all rovers on UDP_PORT, use a multicast group such as 239.0.0.81 or
+// the broadcast address 255.255.255.255
+const bool udp_enabled = false;
+IPAddress udp_address(239, 0, 0, 81);
+
+// Data datagrams covered by each XOR parity datagram, a rover can rebuild one
+// lost datagram per group. Lower values cost more bandwidth and recover more
+// losses. 0 disables forward error correction, max 8.
+const uint8_t udp_fec_group = 4;
+
+// NTRIP caster mountpoints, every mountpoint serves the same correction stream
+const char* ntrip_mountpoints[] = {"TINKER"};
+
+// Upload corrections to an external NTRIP caster as an NTRIP server so rovers
+// can use them without joining this network. NTRIP v1 uses SOURCE with the
+// password only, v2 uses POST with user and password.
+const bool ntrip_upload_enabled = false;
+const char* ntrip_upload_host = "caster.example.com";
+const uint16_t ntrip_upload_port = 2101;
+const char* ntrip_upload_mountpoint = "TINKER";
+const char* ntrip_upload_user = "";
+const char* ntrip_upload_password = "";
+const bool ntrip_upload_v2 = false;
+
+// Record every validated RTCM frame to flash (LittleFS) for post processing,
+// download a GPS time range from http://<base ip>/rtcm_log?from=<s>&to=<s>
+const bool rtcm_log_enabled = false;
+
+// Follow each MSM epoch sent to a raw TCP rover with a small message holding
+// the time the base read it, used by the rover to measure the correction
+// latency. Only rovers that ask for it get it, NTRIP clients and the caster
+// upload never do. The message number is in the RTCM proprietary range, so
+// leave this off when other receivers read the raw stream.
+const bool latency_markers = false;
@@ -0,0 +1,100 @@
+/** NTRIP Caster
+ *  Request parsing and response text for the NTRIP v1/v2 caster run by the
+ *  base station next to the raw correction port. Every mountpoint listed in
+ *  inputs.h serves the same correction stream. Streaming to the clients is
+ *  done by the shared client code in the main sketch, NTRIP v2 clients get
+ *  the stream with chunked transfer encoding.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef NTRIP_CASTER_H
+#define NTRIP_CASTER_H
+
+// Longest request header accepted from a client (bytes)
+#define NTRIP_MAX_REQUEST 384
+
+// Time allowed for a client to send its request (ms)
+#define NTRIP_REQUEST_TIMEOUT 5000
+
+#define NUM_NTRIP_MOUNTPOINTS (sizeof(ntrip_mountpoints) / sizeof(ntrip_mountpoints[0]))
+
+const char ntrip_v1_ok[] = "ICY 200 OK\r\n\r\n";
+
+const char ntrip_v2_ok[] = "HTTP/1.1 200 OK\r\n"
+                           "Ntrip-Version: Ntrip/2.0\r\n"
+                           "Server: NTRIP TinkerRTK/1.0\r\n"
+                           "Content-Type: gnss/data\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "Connection: close\r\n\r\n";
+
+const char ntrip_v2_not_found[] = "HTTP/1.1 404 Not Found\r\n"
+                                  "Ntrip-Version: Ntrip/2.0\r\n"
+                                  "Connection: close\r\n\r\n";
+
+const char ntrip_bad_request[] = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n";
+
+// True once the blank line ending the request header has been received
+bool ntripRequestComplete(const char* request)
+{
+    return strstr(request, "\r\n\r\n") != NULL;
+}
+
+// Read the mountpoint and protocol version from a request header. Returns
+// false if the request is not a GET. An empty mountpoint asks for the
+// sourcetable.
+bool parseNtripRequest(const char* request, char* mountpoint, int size, bool& v2)
+{
+    if (strncmp(request, "GET /", 5) != 0)
+        return false;
+
+    const char* start = request + 5;
+    int length = strcspn(start, " \r\n");
+    if (length >= size)
+        length = size - 1;
+    memcpy(mountpoint, start, length);
+    mountpoint[length] = '\0';
+
+    v2 = strstr(request, "Ntrip-Version: Ntrip/2.0") != NULL;
+    return true;
+}
+
+// Index of a mountpoint in ntrip_mountpoints, -1 if unknown
+int findNtripMountpoint(const char* mountpoint)
+{
+    for (unsigned int i = 0; i < NUM_NTRIP_MOUNTPOINTS; i++)
+    {
+        if (strcmp(mountpoint, ntrip_mountpoints[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Sourcetable response listing every mountpoint at the base position
+String ntripSourcetable(bool v2, double latitude, double longitude)
+{
+    String table = "";
+    for (unsigned int i = 0; i < NUM_NTRIP_MOUNTPOINTS; i++)
+    {
+        table += "STR;" + String(ntrip_mountpoints[i]) + ";TinkerRTK;RTCM 3.3;;2;GPS+GLO+GAL+BDS;;;";
+        table += String(latitude, 4) + ";" + String(longitude, 4) + ";0;0;TinkerRTK;none;N;N;0;\r\n";
+    }
+    table += "ENDSOURCETABLE\r\n";
+
+    String header = v2 ? "HTTP/1.1 200 OK\r\nNtrip-Version: Ntrip/2.0\r\nContent-Type: gnss/sourcetable\r\n" :
+                         "SOURCETABLE 200 OK\r\nContent-Type: text/plain\r\n";
+    header += "Server: NTRIP TinkerRTK/1.0\r\n";
+    header += "Connection: close\r\n";
+    header += "Content-Length: " + String(table.length()) + "\r\n\r\n";
+
+    return header + table;
+}
+
+// Write the framing that starts a chunk of the given length, closing the
+// previous chunk first if one is open. Returns the number of characters.
+int ntripChunkHeader(char* buffer, uint32_t length, bool close_previous)
+{
+    return sprintf(buffer, "%s%lX\r\n", close_previous ? "\r\n" : "", (unsigned long)length);
+}
+
+#endif
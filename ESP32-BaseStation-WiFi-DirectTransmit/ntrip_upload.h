@@ -0,0 +1,428 @@
+/** NTRIP Server Upload
+ *  Pushes the base station's correction stream to an external NTRIP caster
+ *  (NTRIP v1 SOURCE or v2 POST with chunked transfer encoding) so rovers can
+ *  use the corrections without joining the base station's network. The
+ *  socket is never allowed to block: connecting, logging in and streaming
+ *  are steps of a state machine serviced from loop(), and failed attempts
+ *  are retried with an increasing delay. The caster name is looked up in
+ *  the background and the last address found is kept for when a later
+ *  lookup fails.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef NTRIP_UPLOAD_H
+#define NTRIP_UPLOAD_H
+
+#include <lwip/sockets.h>
+#include <fcntl.h>
+#include "dns_lookup.h"
+#include "ntrip_caster.h"
+
+// Time allowed to connect and log in to the caster (ms)
+#define UPLOAD_TIMEOUT 5000
+
+// Delay before reconnecting, doubled after each failure up to the max (ms)
+#define UPLOAD_RETRY_MIN 1000
+#define UPLOAD_RETRY_MAX 60000
+
+// Connection states
+#define UPLOAD_WAITING 0
+#define UPLOAD_CONNECTING 1
+#define UPLOAD_REQUEST 2
+#define UPLOAD_RESPONSE 3
+#define UPLOAD_STREAMING 4
+#define UPLOAD_LOOKUP 5
+
+const char upload_base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Base64 encoding of a string, used for Basic authorization
+String uploadBase64(const String& text)
+{
+    String encoded = "";
+    for (unsigned int i = 0; i < text.length(); i += 3)
+    {
+        int count = text.length() - i < 3 ? text.length() - i : 3;
+
+        // Pack up to three bytes into 24 bits, missing bytes are zero
+        uint32_t group = (uint8_t)text[i] << 16;
+        if (count > 1)
+            group |= (uint8_t)text[i + 1] << 8;
+        if (count > 2)
+            group |= (uint8_t)text[i + 2];
+
+        for (int j = 0; j < 4; j++)
+        {
+            if (j <= count)
+                encoded += upload_base64_chars[(group >> (18 - 6 * j)) & 0x3F];
+            else
+                encoded += '=';
+        }
+    }
+    return encoded;
+}
+
+class NtripUpload
+{
+  public:
+
+    // Set the caster and mountpoint, the first connection is made by service()
+    void begin(const char* caster_host, uint16_t caster_port, const char* mountpoint,
+               const char* user, const char* password, bool v2_request)
+    {
+        host = caster_host;
+        port = caster_port;
+        v2 = v2_request;
+
+        if (v2)
+        {
+            request = "POST /" + String(mountpoint) + " HTTP/1.1\r\n";
+            request += "Host: " + String(host) + "\r\n";
+            request += "Ntrip-Version: Ntrip/2.0\r\n";
+            request += "User-Agent: NTRIP TinkerRTK/1.0\r\n";
+            request += "Authorization: Basic " + uploadBase64(String(user) + ":" + password) + "\r\n";
+            request += "Content-Type: gnss/data\r\n";
+            request += "Transfer-Encoding: chunked\r\n\r\n";
+        }
+        else
+        {
+            request = "SOURCE " + String(password) + " /" + String(mountpoint) + "\r\n";
+            request += "Source-Agent: NTRIP TinkerRTK/1.0\r\n\r\n";
+        }
+
+        retry_delay = UPLOAD_RETRY_MIN;
+        next_attempt = 0;
+        refresh = false;
+        state = UPLOAD_WAITING;
+    }
+
+    // Move the connection along, returns true while corrections can be sent
+    bool service()
+    {
+        switch (state)
+        {
+            case UPLOAD_WAITING:
+                if ((long)(millis() - next_attempt) >= 0)
+                    startConnect();
+                break;
+
+            case UPLOAD_LOOKUP:
+                switch (lookup.poll())
+                {
+                    case LOOKUP_DONE:
+                        address = lookup.address();
+                        refresh = false;
+                        openSocket();
+                        break;
+
+                    case LOOKUP_FAILED:
+                        // Fall back on the last address found
+                        if (address == IPAddress(0, 0, 0, 0))
+                            fail("Caster name lookup failed");
+                        else
+                            openSocket();
+                        break;
+                }
+                break;
+
+            case UPLOAD_CONNECTING:
+                checkConnect();
+                break;
+
+            case UPLOAD_REQUEST:
+                sendRequest();
+                break;
+
+            case UPLOAD_RESPONSE:
+                readResponse();
+                break;
+
+            case UPLOAD_STREAMING:
+                // The caster sends nothing while streaming, data or a zero
+                // length read means it closed the connection
+                {
+                    uint8_t ch;
+                    int n = recv(sock, &ch, 1, MSG_DONTWAIT);
+                    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+                        fail("Caster closed the upload");
+                }
+                break;
+        }
+
+        // The lookup has its own timeout
+        if (state != UPLOAD_STREAMING && state != UPLOAD_WAITING && state != UPLOAD_LOOKUP &&
+            millis() - state_time > UPLOAD_TIMEOUT)
+        {
+            fail("Caster upload timed out");
+        }
+
+        return state == UPLOAD_STREAMING;
+    }
+
+    // Send correction data without blocking, adding chunk framing for v2.
+    // Returns the number of data bytes sent, 0 if the socket cannot take
+    // more right now and -1 if the connection failed.
+    int write(const uint8_t* data, uint32_t length)
+    {
+        if (state != UPLOAD_STREAMING)
+            return -1;
+
+        if (v2)
+        {
+            // Start a new chunk holding the data offered now
+            if (chunk_remaining == 0 && prefix_sent == prefix_length)
+            {
+                prefix_length = ntripChunkHeader(chunk_prefix, length, chunk_open);
+                prefix_sent = 0;
+                chunk_remaining = length;
+                chunk_open = true;
+            }
+
+            while (prefix_sent < prefix_length)
+            {
+                int sent = socketSend((const uint8_t*)chunk_prefix + prefix_sent,
+                                      prefix_length - prefix_sent);
+                if (sent <= 0)
+                    return sent;
+                prefix_sent += sent;
+            }
+
+            if (length > chunk_remaining)
+                length = chunk_remaining;
+        }
+
+        int sent = socketSend(data, length);
+        if (sent > 0)
+        {
+            bytes_sent += sent;
+            if (v2)
+                chunk_remaining -= sent;
+        }
+        return sent;
+    }
+
+    // Compute the upload rate since the last call
+    void updateRate(float seconds)
+    {
+        if (seconds <= 0.0)
+            return;
+        rate = (bytes_sent - last_bytes_sent) / seconds;
+        last_bytes_sent = bytes_sent;
+    }
+
+    // Connection state for the web page
+    const char* status() const
+    {
+        switch (state)
+        {
+            case UPLOAD_LOOKUP: return "Looking up";
+            case UPLOAD_CONNECTING: return "Connecting";
+            case UPLOAD_REQUEST:
+            case UPLOAD_RESPONSE: return "Logging in";
+            case UPLOAD_STREAMING: return "Streaming";
+            default: return connects > 0 || failures > 0 ? "Retrying" : "Waiting";
+        }
+    }
+
+    bool streaming() const { return state == UPLOAD_STREAMING; }
+
+    // Close the stream when it cannot be continued without a broken frame,
+    // the caster is connected again after the retry delay
+    void restart(const char* reason)
+    {
+        fail(reason);
+    }
+
+    // Statistics
+    unsigned long bytes_sent = 0;
+    unsigned long connects = 0;
+    unsigned long failures = 0;
+    float rate = 0.0;
+
+  private:
+
+    // Look the caster name up the first time and again after a failed
+    // connection, other attempts reuse the address
+    void startConnect()
+    {
+        if (address == IPAddress(0, 0, 0, 0) || refresh)
+        {
+            lookup.start(host);
+            setState(UPLOAD_LOOKUP);
+            return;
+        }
+        openSocket();
+    }
+
+    // Open a non-blocking socket and start connecting to the caster
+    void openSocket()
+    {
+        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (sock < 0)
+        {
+            fail("Upload socket failed");
+            return;
+        }
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+        struct sockaddr_in server;
+        memset(&server, 0, sizeof(server));
+        server.sin_family = AF_INET;
+        server.sin_port = htons(port);
+        server.sin_addr.s_addr = (uint32_t)address;
+
+        // Corrections are already coalesced per epoch, send them right away
+        int no_delay = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+        if (connect(sock, (struct sockaddr*)&server, sizeof(server)) < 0 && errno != EINPROGRESS)
+        {
+            fail("Caster connect failed");
+            return;
+        }
+
+        setState(UPLOAD_CONNECTING);
+    }
+
+    // Check whether the connection has been made
+    void checkConnect()
+    {
+        fd_set write_set;
+        FD_ZERO(&write_set);
+        FD_SET(sock, &write_set);
+        struct timeval no_wait = {0, 0};
+
+        if (select(sock + 1, NULL, &write_set, NULL, &no_wait) <= 0)
+            return;
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0)
+        {
+            fail("Caster connect failed");
+            return;
+        }
+
+        request_sent = 0;
+        setState(UPLOAD_REQUEST);
+    }
+
+    // Send the SOURCE or POST request
+    void sendRequest()
+    {
+        int sent = socketSend((const uint8_t*)request.c_str() + request_sent, request.length() - request_sent);
+        if (sent < 0)
+            return;
+
+        request_sent += sent;
+        if (request_sent == request.length())
+        {
+            response_length = 0;
+            setState(UPLOAD_RESPONSE);
+        }
+    }
+
+    // Wait for the caster to accept the upload
+    void readResponse()
+    {
+        int n = recv(sock, response + response_length, sizeof(response) - 1 - response_length, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            fail("Caster closed the upload");
+            return;
+        }
+        if (n < 0)
+            return;
+
+        response_length += n;
+        response[response_length] = '\0';
+        if (strstr(response, "\r\n") == NULL && response_length < sizeof(response) - 1)
+            return;
+
+        if (strncmp(response, "ICY 200", 7) == 0 ||
+            (strncmp(response, "HTTP/1.", 7) == 0 && strncmp(response + 8, " 200", 4) == 0))
+        {
+            connects++;
+            retry_delay = UPLOAD_RETRY_MIN;
+            prefix_length = 0;
+            prefix_sent = 0;
+            chunk_remaining = 0;
+            chunk_open = false;
+            setState(UPLOAD_STREAMING);
+            Serial.print(millis());Serial.println(" Uploading corrections to caster");
+        }
+        else
+        {
+            fail("Caster refused the upload");
+        }
+    }
+
+    // Non-blocking send, returns the number of bytes sent, 0 if the send
+    // buffer is full and -1 after closing a failed connection
+    int socketSend(const uint8_t* data, uint32_t length)
+    {
+        int sent = send(sock, data, length, MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            fail("Caster upload failed");
+            return -1;
+        }
+        return sent;
+    }
+
+    // Close the connection and schedule the next attempt
+    void fail(const char* reason)
+    {
+        Serial.print(millis());Serial.print(" ");Serial.println(reason);
+
+        if (sock >= 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+        if (state == UPLOAD_CONNECTING)
+            refresh = true;
+
+        failures++;
+        next_attempt = millis() + retry_delay;
+        retry_delay = retry_delay * 2 > UPLOAD_RETRY_MAX ? UPLOAD_RETRY_MAX : retry_delay * 2;
+        setState(UPLOAD_WAITING);
+    }
+
+    void setState(uint8_t new_state)
+    {
+        state = new_state;
+        state_time = millis();
+    }
+
+    const char* host = "";
+    uint16_t port = 2101;
+    bool v2 = false;
+    IPAddress address;
+    DNSLookup lookup;
+    bool refresh = false;
+    String request;
+    unsigned int request_sent = 0;
+    char response[64];
+    unsigned int response_length = 0;
+
+    int sock = -1;
+    uint8_t state = UPLOAD_WAITING;
+    unsigned long state_time = 0;
+    unsigned long next_attempt = 0;
+    unsigned long retry_delay = UPLOAD_RETRY_MIN;
+
+    // Chunk framing not yet sent and payload left in the open chunk
+    char chunk_prefix[16];
+    uint8_t prefix_length = 0;
+    uint8_t prefix_sent = 0;
+    uint32_t chunk_remaining = 0;
+    bool chunk_open = false;
+
+    unsigned long last_bytes_sent = 0;
+};
+
+#endif
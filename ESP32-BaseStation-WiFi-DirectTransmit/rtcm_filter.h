@@ -0,0 +1,147 @@
+/** RTCM Message Filter
+ *  Per message type forwarding rules applied to each frame before it is
+ *  stored for the rovers. A message can be passed, dropped, or decimated so
+ *  that it is only sent every Nth epoch. Epochs are counted from the MSM
+ *  multiple message bit, which is clear on the last MSM of an epoch.
+ *  Messages without a rule are passed.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef RTCM_FILTER_H
+#define RTCM_FILTER_H
+
+enum RTCMAction
+{
+    RTCM_PASS,
+    RTCM_DROP,
+    RTCM_DECIMATE
+};
+
+struct RTCMRule
+{
+    uint16_t message_type;
+    RTCMAction action;
+    // Send every Nth epoch when decimating
+    uint16_t divisor;
+
+    // Filled in while running
+    bool sent_once;
+    unsigned long last_epoch;
+    unsigned long bytes_in;
+    unsigned long bytes_out;
+
+    // Byte rates (bytes/s) over the last updateRates() period
+    float rate_in;
+    float rate_out;
+    unsigned long last_bytes_in;
+    unsigned long last_bytes_out;
+};
+
+// Forwarding rules, edit to match the signals used by the rovers. Station
+// position and antenna messages change rarely and are sent every 10th epoch.
+RTCMRule rtcm_rules[] =
+{
+    {1005, RTCM_DECIMATE, 10},
+    {1006, RTCM_DECIMATE, 10},
+    {1007, RTCM_DECIMATE, 10},
+    {1008, RTCM_DECIMATE, 10},
+    {1033, RTCM_DECIMATE, 10},
+    {1230, RTCM_DECIMATE, 10},
+};
+#define NUM_RTCM_RULES (sizeof(rtcm_rules) / sizeof(rtcm_rules[0]))
+
+class RTCMFilter
+{
+  public:
+
+    // Returns true if a frame of this type and length should be forwarded
+    bool allow(uint16_t message_type, uint16_t length)
+    {
+        bytes_in += length;
+
+        RTCMRule* rule = findRule(message_type);
+        bool pass = true;
+        if (rule != NULL)
+        {
+            rule->bytes_in += length;
+            if (rule->action == RTCM_DROP)
+            {
+                pass = false;
+            }
+            else if (rule->action == RTCM_DECIMATE)
+            {
+                pass = !rule->sent_once || epoch - rule->last_epoch >= rule->divisor;
+                if (pass)
+                {
+                    rule->sent_once = true;
+                    rule->last_epoch = epoch;
+                }
+            }
+            if (pass)
+                rule->bytes_out += length;
+        }
+
+        if (pass)
+            bytes_out += length;
+        return pass;
+    }
+
+    // Called after the last MSM frame of an epoch
+    void endOfEpoch()
+    {
+        epoch++;
+    }
+
+    // Compute byte rates for each rule and in total since the last call
+    void updateRates(float seconds)
+    {
+        if (seconds <= 0.0)
+            return;
+
+        for (unsigned int i = 0; i < NUM_RTCM_RULES; i++)
+        {
+            RTCMRule& rule = rtcm_rules[i];
+            rule.rate_in = (rule.bytes_in - rule.last_bytes_in) / seconds;
+            rule.rate_out = (rule.bytes_out - rule.last_bytes_out) / seconds;
+            rule.last_bytes_in = rule.bytes_in;
+            rule.last_bytes_out = rule.bytes_out;
+        }
+
+        rate_in = (bytes_in - last_bytes_in) / seconds;
+        rate_out = (bytes_out - last_bytes_out) / seconds;
+        last_bytes_in = bytes_in;
+        last_bytes_out = bytes_out;
+    }
+
+    // Percentage of the received bytes that were not forwarded
+    float reduction() const
+    {
+        if (bytes_in == 0)
+            return 0.0;
+        return 100.0 * (bytes_in - bytes_out) / bytes_in;
+    }
+
+    unsigned long epoch = 0;
+    unsigned long bytes_in = 0;
+    unsigned long bytes_out = 0;
+    float rate_in = 0.0;
+    float rate_out = 0.0;
+
+  private:
+
+    unsigned long last_bytes_in = 0;
+    unsigned long last_bytes_out = 0;
+
+    RTCMRule* findRule(uint16_t message_type)
+    {
+        for (unsigned int i = 0; i < NUM_RTCM_RULES; i++)
+        {
+            if (rtcm_rules[i].message_type == message_type)
+                return &rtcm_rules[i];
+        }
+        return NULL;
+    }
+};
+
+#endif
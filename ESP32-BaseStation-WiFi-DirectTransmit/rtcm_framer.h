@@ -0,0 +1,196 @@
+/** RTCM3 Framer
+ *  Streaming detector for RTCM3 transport frames. Bytes are added one at a time
+ *  or in blocks as they arrive and a frame is reported as soon as its last
+ *  CRC byte has been received and checked. Blocks are copied a frame at a
+ *  time once the length field is known. Bytes buffered after a frame that
+ *  was found by resynchronizing are kept and searched first, a frame among
+ *  them is reported by the next call.
+ *  Frame layout: 0xD3 preamble, 6 reserved bits, 10 bit length, payload, CRC-24Q
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef RTCM_FRAMER_H
+#define RTCM_FRAMER_H
+
+#include "crc24q.h"
+
+#define RTCM_PREAMBLE 0xD3
+#define RTCM_HEADER_LENGTH 3
+#define RTCM_CRC_LENGTH 3
+#define RTCM_MAX_PAYLOAD_LENGTH 1023
+#define RTCM_MAX_FRAME_LENGTH (RTCM_HEADER_LENGTH + RTCM_MAX_PAYLOAD_LENGTH + RTCM_CRC_LENGTH)
+
+class RTCMFramer
+{
+  public:
+
+    // Add a received byte, returns true when a complete frame with a valid
+    // CRC is available through frame() and frameLength()
+    bool addByte(uint8_t ch)
+    {
+        // Previous frame has been handed out, start a new one
+        if (frame_length != 0)
+            nextFrame();
+
+        // Discard bytes until a preamble is found
+        if (count == 0 && ch != RTCM_PREAMBLE)
+        {
+            bytes_discarded++;
+            return false;
+        }
+
+        buffer[count++] = ch;
+
+        return checkBuffer();
+    }
+
+    // Add a block of received bytes, returns the number used. Adding stops
+    // after the byte that completes a frame, frameLength() is then non zero
+    // until more bytes are added. A frame already buffered is reported
+    // without using any bytes, so call again while frameLength() is non zero
+    // even when all the bytes have been used.
+    uint16_t addBytes(const uint8_t* data, uint16_t length)
+    {
+        uint16_t used = 0;
+        if (frame_length != 0)
+        {
+            nextFrame();
+            if (checkBuffer())
+                return 0;
+        }
+
+        while (used < length)
+        {
+            // Discard bytes until a preamble is found
+            if (count == 0)
+            {
+                const uint8_t* start = (const uint8_t*)memchr(data + used, RTCM_PREAMBLE, length - used);
+                uint16_t skip = start != NULL ? start - (data + used) : length - used;
+                bytes_discarded += skip;
+                used += skip;
+                if (start == NULL)
+                    break;
+            }
+
+            // Copy up to the end of the header, or of the frame once its
+            // length is known. checkBuffer() leaves fewer bytes than needed.
+            uint16_t needed = count < RTCM_HEADER_LENGTH ? RTCM_HEADER_LENGTH : bufferFrameLength();
+            uint16_t n = needed - count;
+            if (n > length - used)
+                n = length - used;
+            memcpy(buffer + count, data + used, n);
+            count += n;
+            used += n;
+
+            if (checkBuffer())
+                break;
+        }
+        return used;
+    }
+
+    // Drop any partially received frame, used when the stream is broken
+    // off so that the start of the next stream is not joined to it
+    void reset()
+    {
+        if (count > 0 && frame_length == 0)
+            resyncs++;
+        bytes_discarded += count - frame_length;
+        count = 0;
+        frame_length = 0;
+    }
+
+    const uint8_t* frame() const { return buffer; }
+    uint16_t frameLength() const { return frame_length; }
+    uint16_t payloadLength() const { return frame_length - RTCM_HEADER_LENGTH - RTCM_CRC_LENGTH; }
+
+    // 12 bit message number from the start of the payload
+    uint16_t messageType() const
+    {
+        return ((uint16_t)buffer[3] << 4) | (buffer[4] >> 4);
+    }
+
+    // Statistics
+    unsigned long frames_received = 0;
+    unsigned long frames_failed = 0;
+    unsigned long bytes_discarded = 0;
+
+    // Times framing was lost and searched for again
+    unsigned long resyncs = 0;
+
+  private:
+
+    // Check the buffered bytes for a complete frame, resynchronizing on the
+    // next preamble in the buffer when the header or CRC is invalid
+    bool checkBuffer()
+    {
+        while (count > 0)
+        {
+            if (count < RTCM_HEADER_LENGTH)
+                return false;
+
+            // Upper six bits of the length field are reserved and always zero
+            bool valid = (buffer[1] & 0xFC) == 0;
+            if (valid)
+            {
+                uint16_t length = bufferFrameLength();
+                if (count < length)
+                    return false;
+
+                uint32_t crc = ((uint32_t)buffer[length-3] << 16) |
+                               ((uint32_t)buffer[length-2] << 8) |
+                                buffer[length-1];
+                if (crc24q(buffer, length - RTCM_CRC_LENGTH) == crc)
+                {
+                    frame_length = length;
+                    frames_received++;
+                    return true;
+                }
+                frames_failed++;
+            }
+
+            resync();
+        }
+        return false;
+    }
+
+    // Move the bytes buffered after the frame that was handed out to the
+    // start of the buffer, from the next preamble
+    void nextFrame()
+    {
+        uint16_t next = frame_length;
+        while (next < count && buffer[next] != RTCM_PREAMBLE)
+            next++;
+
+        bytes_discarded += next - frame_length;
+        memmove(buffer, buffer + next, count - next);
+        count -= next;
+        frame_length = 0;
+    }
+
+    // Frame length given by the buffered header
+    uint16_t bufferFrameLength() const
+    {
+        return (((uint16_t)buffer[1] & 0x03) << 8 | buffer[2]) + RTCM_HEADER_LENGTH + RTCM_CRC_LENGTH;
+    }
+
+    // Shift the buffer to the next preamble after the current one
+    void resync()
+    {
+        uint16_t next = 1;
+        while (next < count && buffer[next] != RTCM_PREAMBLE)
+            next++;
+
+        resyncs++;
+        bytes_discarded += next;
+        memmove(buffer, buffer + next, count - next);
+        count -= next;
+        frame_length = 0;
+    }
+
+    uint8_t buffer[RTCM_MAX_FRAME_LENGTH];
+    uint16_t count = 0;
+    uint16_t frame_length = 0;
+};
+
+#endif
@@ -0,0 +1,492 @@
+/** RTCM Recording Log
+ *  Keeps the validated correction stream on flash (LittleFS) for post
+ *  processing and for looking into a bad session afterwards. Frames are
+ *  gathered in RAM pages that always start on a frame boundary. Full pages
+ *  are handed to a writer task, so loop() never waits on the flash. The log
+ *  is a ring of fixed size segment files, the oldest segment is deleted when
+ *  a new one is needed, and LittleFS spreads the writes over the flash.
+ *  Every page is indexed by the GPS time of week of the last MSM epoch seen
+ *  when the page was started, so a time range can be found without reading
+ *  the segments. The index is kept in a file, the entry of the open segment
+ *  is rewritten after every page so a reset loses none of it.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef RTCM_LOG_H
+#define RTCM_LOG_H
+
+#include <LittleFS.h>
+
+// Size of a RAM page handed to the writer task (bytes)
+#define RTCM_LOG_PAGE_SIZE 4096
+
+// Number of RAM pages, pages beyond the one being filled absorb slow writes
+#define RTCM_LOG_BUFFERS 4
+
+// Segment files kept and size at which a segment is closed (bytes), the
+// product must fit in the LittleFS partition
+#define RTCM_LOG_SEGMENTS 16
+#define RTCM_LOG_SEGMENT_SIZE 65536
+
+// Max indexed pages per segment
+#define RTCM_LOG_MAX_PAGES 24
+
+// A partly filled page is written after this time so recent data can be
+// downloaded (ms)
+#define RTCM_LOG_PAGE_AGE 10000
+
+#define RTCM_LOG_DIR "/rtcm"
+#define RTCM_LOG_INDEX "/rtcm/index.bin"
+
+// Page start within a segment and its GPS time of week (ms)
+struct RTCMLogPage
+{
+    uint32_t offset;
+    uint32_t gnss_time;
+};
+
+// Segment file summary, id 0 marks an unused slot
+struct RTCMLogSegment
+{
+    uint32_t id;
+    uint32_t bytes;
+    uint16_t num_pages;
+    RTCMLogPage pages[RTCM_LOG_MAX_PAGES];
+};
+
+// Part of a segment file selected for download
+struct RTCMLogSpan
+{
+    uint32_t id;
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct RTCMLogBuffer
+{
+    uint16_t length;
+    uint32_t gnss_time;
+    unsigned long start_time;
+    uint8_t data[RTCM_LOG_PAGE_SIZE];
+};
+
+// Path of a segment file
+String rtcmLogPath(uint32_t id)
+{
+    char path[32];
+    sprintf(path, RTCM_LOG_DIR "/%08lu.bin", (unsigned long)id);
+    return String(path);
+}
+
+class RTCMLog
+{
+  public:
+
+    // Mount the file system, load the index and start the writer task
+    bool begin()
+    {
+        if (!LittleFS.begin(true))
+            return false;
+        LittleFS.mkdir(RTCM_LOG_DIR);
+
+        index_lock = xSemaphoreCreateMutex();
+        free_queue = xQueueCreate(RTCM_LOG_BUFFERS, sizeof(uint8_t));
+        full_queue = xQueueCreate(RTCM_LOG_BUFFERS, sizeof(uint8_t));
+        for (uint8_t i = 0; i < RTCM_LOG_BUFFERS; i++)
+            xQueueSend(free_queue, &i, 0);
+
+        loadIndex();
+
+        // Same priority as the Arduino loop task, which never blocks, so the
+        // two share the CPU in time slices. At the idle priority the writer
+        // would only run when loop() sleeps and the pages would fill up.
+        // The writer blocks on the page queue while there is nothing to write.
+        xTaskCreate(writerTask, "rtcm_log", 4096, this, tskIDLE_PRIORITY + 1, NULL);
+        running = true;
+        return true;
+    }
+
+    // Append a validated frame, called from loop(). Never waits: the frame
+    // is dropped if every page is still waiting to be written.
+    void add(const uint8_t* frame, uint16_t length, uint32_t gnss_time)
+    {
+        if (!running || length > RTCM_LOG_PAGE_SIZE)
+            return;
+
+        unsigned long start = micros();
+
+        // Hand over the current page when the frame does not fit or the
+        // page has been open too long
+        if (current >= 0 &&
+            (buffers[current].length + length > RTCM_LOG_PAGE_SIZE ||
+             millis() - buffers[current].start_time > RTCM_LOG_PAGE_AGE))
+        {
+            uint8_t page = current;
+            xQueueSend(full_queue, &page, 0);
+            current = -1;
+        }
+
+        if (current < 0)
+        {
+            uint8_t page;
+            if (xQueueReceive(free_queue, &page, 0) != pdTRUE)
+            {
+                frames_dropped++;
+                return;
+            }
+            current = page;
+            buffers[page].length = 0;
+            buffers[page].gnss_time = gnss_time;
+            buffers[page].start_time = millis();
+        }
+
+        RTCMLogBuffer& buffer = buffers[current];
+        memcpy(buffer.data + buffer.length, frame, length);
+        buffer.length += length;
+        frames_logged++;
+
+        unsigned long elapsed = micros() - start;
+        add_time_total += elapsed;
+        if (elapsed > add_time_max)
+            add_time_max = elapsed;
+    }
+
+    // Select the parts of the log covering GPS time of week from_ms to
+    // to_ms, oldest first. Returns the number of spans.
+    int selectRange(uint32_t from_ms, uint32_t to_ms, RTCMLogSpan* spans, int max_spans)
+    {
+        int num_spans = 0;
+        xSemaphoreTake(index_lock, portMAX_DELAY);
+        for (uint32_t id = oldestId(); id != 0 && id <= last_id && num_spans < max_spans; id++)
+        {
+            const RTCMLogSegment& segment = segments[id % RTCM_LOG_SEGMENTS];
+            if (segment.id != id || segment.bytes == 0)
+                continue;
+
+            // The last page ends where the next segment starts
+            uint32_t end_time = 0xFFFFFFFF;
+            const RTCMLogSegment& next = segments[(id + 1) % RTCM_LOG_SEGMENTS];
+            if (next.id == id + 1 && next.num_pages > 0)
+                end_time = next.pages[0].gnss_time;
+
+            // Pages overlap the range if they start before its end and the
+            // next page starts after its beginning
+            int first = -1, last = -1;
+            for (int i = 0; i < segment.num_pages; i++)
+            {
+                uint32_t next_time = i + 1 < segment.num_pages ? segment.pages[i + 1].gnss_time : end_time;
+                if (segment.pages[i].gnss_time <= to_ms && next_time >= from_ms)
+                {
+                    if (first < 0)
+                        first = i;
+                    last = i;
+                }
+            }
+
+            // Segments written before a restart may have no page index
+            if (segment.num_pages == 0 && from_ms == 0)
+            {
+                spans[num_spans++] = {id, 0, segment.bytes};
+                continue;
+            }
+            if (first < 0)
+                continue;
+
+            uint32_t start = segment.pages[first].offset;
+            uint32_t end = last + 1 < segment.num_pages ? segment.pages[last + 1].offset : segment.bytes;
+            spans[num_spans++] = {id, start, end - start};
+        }
+        xSemaphoreGive(index_lock);
+        return num_spans;
+    }
+
+    // Segment list with their time ranges as JSON
+    int indexJSON(char* buffer, int size)
+    {
+        int n = snprintf(buffer, size, "[");
+        xSemaphoreTake(index_lock, portMAX_DELAY);
+        bool first = true;
+        for (uint32_t id = oldestId(); id != 0 && id <= last_id && n < size; id++)
+        {
+            const RTCMLogSegment& segment = segments[id % RTCM_LOG_SEGMENTS];
+            if (segment.id != id)
+                continue;
+            uint32_t from = segment.num_pages > 0 ? segment.pages[0].gnss_time : 0;
+            uint32_t to = segment.num_pages > 0 ? segment.pages[segment.num_pages - 1].gnss_time : 0;
+            n += snprintf(buffer + n, size - n, "%s{\"id\":%lu,\"bytes\":%lu,\"from\":%lu,\"to\":%lu}",
+                          first ? "" : ",", (unsigned long)id, (unsigned long)segment.bytes,
+                          (unsigned long)from, (unsigned long)to);
+            first = false;
+        }
+        xSemaphoreGive(index_lock);
+        if (n < size)
+            n += snprintf(buffer + n, size - n, "]");
+        return n < size ? n : size - 1;
+    }
+
+    // Compute the write rate since the last call
+    void updateRate(float seconds)
+    {
+        if (seconds <= 0.0)
+            return;
+        write_rate = (bytes_written - last_bytes_written) / seconds;
+        last_bytes_written = bytes_written;
+    }
+
+    bool running = false;
+
+    // Statistics, times in us
+    unsigned long frames_logged = 0;
+    unsigned long frames_dropped = 0;
+    unsigned long add_time_total = 0;
+    unsigned long add_time_max = 0;
+    volatile unsigned long pages_written = 0;
+    volatile unsigned long bytes_written = 0;
+    volatile unsigned long write_time_total = 0;
+    volatile unsigned long write_time_max = 0;
+    volatile unsigned long write_errors = 0;
+    float write_rate = 0.0;
+
+  private:
+
+    static void writerTask(void* parameter)
+    {
+        ((RTCMLog*)parameter)->writeLoop();
+    }
+
+    // Write full pages to the open segment as they arrive
+    void writeLoop()
+    {
+        for (;;)
+        {
+            uint8_t page;
+            if (!xQueueReceive(full_queue, &page, portMAX_DELAY))
+                continue;
+
+            RTCMLogBuffer& buffer = buffers[page];
+            RTCMLogSegment& segment = segments[last_id % RTCM_LOG_SEGMENTS];
+            if (!file || segment.bytes + buffer.length > RTCM_LOG_SEGMENT_SIZE ||
+                segment.num_pages == RTCM_LOG_MAX_PAGES)
+            {
+                openSegment();
+            }
+
+            unsigned long start = micros();
+            size_t written = file.write(buffer.data, buffer.length);
+            file.flush();
+            unsigned long elapsed = micros() - start;
+
+            if (written == buffer.length)
+            {
+                RTCMLogSegment& open = segments[last_id % RTCM_LOG_SEGMENTS];
+                xSemaphoreTake(index_lock, portMAX_DELAY);
+                open.pages[open.num_pages].offset = open.bytes;
+                open.pages[open.num_pages].gnss_time = buffer.gnss_time;
+                open.num_pages++;
+                open.bytes += buffer.length;
+                xSemaphoreGive(index_lock);
+                saveSegment(last_id);
+
+                pages_written++;
+                bytes_written += buffer.length;
+            }
+            else
+            {
+                write_errors++;
+            }
+
+            write_time_total += elapsed;
+            if (elapsed > write_time_max)
+                write_time_max = elapsed;
+
+            xQueueSend(free_queue, &page, 0);
+        }
+    }
+
+    // Close the current segment and start the next one, deleting the
+    // oldest segment when its slot is needed
+    void openSegment()
+    {
+        if (file)
+        {
+            file.close();
+        }
+
+        uint32_t id = last_id + 1;
+        RTCMLogSegment& segment = segments[id % RTCM_LOG_SEGMENTS];
+        if (segment.id != 0)
+            LittleFS.remove(rtcmLogPath(segment.id));
+
+        xSemaphoreTake(index_lock, portMAX_DELAY);
+        segment.id = id;
+        segment.bytes = 0;
+        segment.num_pages = 0;
+        last_id = id;
+        xSemaphoreGive(index_lock);
+
+        saveIndex();
+        file = LittleFS.open(rtcmLogPath(id), "w");
+    }
+
+    // Read the saved index, sizes come from the files themselves since the
+    // last segment may have grown after the index was saved
+    void loadIndex()
+    {
+        memset(segments, 0, sizeof(segments));
+        File index = LittleFS.open(RTCM_LOG_INDEX, "r");
+        if (index && index.size() == sizeof(segments))
+            index.read((uint8_t*)segments, sizeof(segments));
+        if (index)
+            index.close();
+
+        last_id = 0;
+        for (int i = 0; i < RTCM_LOG_SEGMENTS; i++)
+        {
+            RTCMLogSegment& segment = segments[i];
+            if (segment.id == 0)
+                continue;
+
+            File data = LittleFS.open(rtcmLogPath(segment.id), "r");
+            if (!data)
+            {
+                memset(&segment, 0, sizeof(segment));
+                continue;
+            }
+            segment.bytes = data.size();
+            data.close();
+
+            // Drop index entries past the end of the file
+            while (segment.num_pages > 0 && segment.pages[segment.num_pages - 1].offset >= segment.bytes)
+                segment.num_pages--;
+
+            if (segment.id > last_id)
+                last_id = segment.id;
+        }
+    }
+
+    void saveIndex()
+    {
+        File index = LittleFS.open(RTCM_LOG_INDEX, "w");
+        if (!index)
+            return;
+        xSemaphoreTake(index_lock, portMAX_DELAY);
+        index.write((const uint8_t*)segments, sizeof(segments));
+        xSemaphoreGive(index_lock);
+        index.close();
+    }
+
+    // Rewrite one segment's index entry in place, the whole index is
+    // written if the file is missing or from another build
+    void saveSegment(uint32_t id)
+    {
+        File index = LittleFS.open(RTCM_LOG_INDEX, "r+");
+        if (!index || index.size() != sizeof(segments))
+        {
+            if (index)
+                index.close();
+            saveIndex();
+            return;
+        }
+
+        uint32_t slot = id % RTCM_LOG_SEGMENTS;
+        if (index.seek(slot * sizeof(RTCMLogSegment)))
+        {
+            xSemaphoreTake(index_lock, portMAX_DELAY);
+            index.write((const uint8_t*)&segments[slot], sizeof(RTCMLogSegment));
+            xSemaphoreGive(index_lock);
+        }
+        index.close();
+    }
+
+    uint32_t oldestId() const
+    {
+        if (last_id == 0)
+            return 0;
+        return last_id >= RTCM_LOG_SEGMENTS ? last_id - RTCM_LOG_SEGMENTS + 1 : 1;
+    }
+
+    RTCMLogBuffer buffers[RTCM_LOG_BUFFERS];
+    int current = -1;
+    QueueHandle_t free_queue;
+    QueueHandle_t full_queue;
+
+    RTCMLogSegment segments[RTCM_LOG_SEGMENTS];
+    uint32_t last_id = 0;
+    SemaphoreHandle_t index_lock;
+    File file;
+
+    unsigned long last_bytes_written = 0;
+};
+
+// Streams the selected spans of the log to an HTTP response
+class RTCMLogReader
+{
+  public:
+
+    // Total number of bytes to be sent
+    uint32_t length() const
+    {
+        uint32_t total = 0;
+        for (int i = 0; i < num_spans; i++)
+            total += spans[i].length;
+        return total;
+    }
+
+    // Fill buffer with the next bytes, returns 0 at the end
+    size_t read(uint8_t* buffer, size_t max_length)
+    {
+        size_t count = 0;
+        while (count < max_length && span < num_spans)
+        {
+            RTCMLogSpan& current = spans[span];
+            if (position == 0 && !file)
+            {
+                file = LittleFS.open(rtcmLogPath(current.id), "r");
+                if (file && !file.seek(current.offset))
+                    file.close();
+            }
+
+            size_t wanted = current.length - position < max_length - count ?
+                            current.length - position : max_length - count;
+            int n = file ? file.read(buffer + count, wanted) : 0;
+            if (n <= 0)
+            {
+                // Segment deleted or shorter than indexed since the request,
+                // send zeros so the response keeps its length
+                memset(buffer + count, 0, wanted);
+                n = wanted;
+            }
+            count += n;
+            position += n;
+            if (position == current.length)
+                nextSpan();
+        }
+        return count;
+    }
+
+    ~RTCMLogReader()
+    {
+        if (file)
+            file.close();
+    }
+
+    RTCMLogSpan spans[RTCM_LOG_SEGMENTS];
+    int num_spans = 0;
+
+  private:
+
+    void nextSpan()
+    {
+        if (file)
+            file.close();
+        span++;
+        position = 0;
+    }
+
+    int span = 0;
+    uint32_t position = 0;
+    File file;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/** RTCM Statistics
+ *  Per message type throughput counters kept in a fixed size table: frame and
+ *  byte rates, min/max frame size and a histogram of inter-arrival jitter
+ *  (change in time between frames of the same type). Frames are timed by
+ *  their UART arrival time (us, see latency.h) so loop() delays do not show
+ *  up as jitter. No heap is used, the
+ *  table is written out as compact JSON into a caller supplied buffer.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef RTCM_STATS_H
+#define RTCM_STATS_H
+
+// Max number of message types tracked
+#define RTCM_STATS_TYPES 24
+
+// Jitter histogram bins, upper bounds in ms, the last bin is open ended
+#define RTCM_JITTER_BINS 8
+const uint16_t rtcm_jitter_bounds[RTCM_JITTER_BINS - 1] = {1, 2, 5, 10, 20, 50, 100};
+
+// Rates written to JSON are capped so that they fit the entry width
+#define RTCM_STATS_MAX_RATE 999999999.0
+
+// Longest JSON entry: 47 characters of names and punctuation, the widest
+// type, capped rates, count and lengths (48) and 11 per jitter bin
+#define RTCM_STATS_JSON_ENTRY (47 + 48 + 11 * RTCM_JITTER_BINS)
+
+// Buffer that holds the JSON for a full table
+#define RTCM_STATS_JSON_SIZE (RTCM_STATS_TYPES * RTCM_STATS_JSON_ENTRY + 3)
+
+struct RTCMTypeStats
+{
+    uint16_t message_type;
+    unsigned long frames;
+    unsigned long bytes;
+    uint16_t min_length;
+    uint16_t max_length;
+    // Arrival time of the last frame and the interval before it (us)
+    uint32_t last_time;
+    uint32_t last_interval;
+    unsigned long jitter[RTCM_JITTER_BINS];
+
+    // Rates over the last updateRates() period
+    float frame_rate;
+    float byte_rate;
+    unsigned long last_frames;
+    unsigned long last_bytes;
+};
+
+class RTCMStats
+{
+  public:
+
+    // Count a frame of this type and length arriving at time_us
+    void add(uint16_t message_type, uint16_t length, uint32_t time_us)
+    {
+        RTCMTypeStats* entry = find(message_type);
+        if (entry == NULL)
+        {
+            untracked_frames++;
+            return;
+        }
+
+        if (entry->frames == 0)
+        {
+            entry->min_length = length;
+            entry->max_length = length;
+        }
+        else
+        {
+            if (length < entry->min_length)
+                entry->min_length = length;
+            if (length > entry->max_length)
+                entry->max_length = length;
+
+            uint32_t interval = time_us - entry->last_time;
+            if (entry->frames > 1)
+            {
+                uint32_t jitter = interval > entry->last_interval ?
+                                  interval - entry->last_interval :
+                                  entry->last_interval - interval;
+                int bin = 0;
+                while (bin < RTCM_JITTER_BINS - 1 && jitter >= rtcm_jitter_bounds[bin] * 1000UL)
+                    bin++;
+                entry->jitter[bin]++;
+            }
+            entry->last_interval = interval;
+        }
+
+        entry->last_time = time_us;
+        entry->frames++;
+        entry->bytes += length;
+    }
+
+    // Compute frame and byte rates since the last call
+    void updateRates(float seconds)
+    {
+        if (seconds <= 0.0)
+            return;
+
+        for (int i = 0; i < num_types; i++)
+        {
+            RTCMTypeStats& entry = table[i];
+            entry.frame_rate = (entry.frames - entry.last_frames) / seconds;
+            entry.byte_rate = (entry.bytes - entry.last_bytes) / seconds;
+            entry.last_frames = entry.frames;
+            entry.last_bytes = entry.bytes;
+        }
+    }
+
+    // Write the table as JSON, returns the number of characters written. A
+    // buffer of RTCM_STATS_JSON_SIZE always holds the whole table.
+    int toJSON(char* buffer, int size) const
+    {
+        int n = snprintf(buffer, size, "[");
+        for (int i = 0; i < num_types && n < size; i++)
+        {
+            const RTCMTypeStats& entry = table[i];
+            n += snprintf(buffer + n, size - n,
+                          "%s{\"t\":%u,\"fps\":%.2f,\"bps\":%.0f,\"n\":%lu,\"min\":%u,\"max\":%u,\"j\":[",
+                          i == 0 ? "" : ",", entry.message_type,
+                          fminf(entry.frame_rate, RTCM_STATS_MAX_RATE), fminf(entry.byte_rate, RTCM_STATS_MAX_RATE),
+                          entry.frames, entry.min_length, entry.max_length);
+            for (int bin = 0; bin < RTCM_JITTER_BINS && n < size; bin++)
+            {
+                n += snprintf(buffer + n, size - n, "%s%lu", bin == 0 ? "" : ",", entry.jitter[bin]);
+            }
+            if (n < size)
+                n += snprintf(buffer + n, size - n, "]}");
+        }
+        if (n < size)
+            n += snprintf(buffer + n, size - n, "]");
+        return n < size ? n : size - 1;
+    }
+
+    // Frames of types that did not fit in the table
+    unsigned long untracked_frames = 0;
+
+  private:
+
+    // Find or add the entry for a message type
+    RTCMTypeStats* find(uint16_t message_type)
+    {
+        for (int i = 0; i < num_types; i++)
+        {
+            if (table[i].message_type == message_type)
+                return &table[i];
+        }
+
+        if (num_types == RTCM_STATS_TYPES)
+            return NULL;
+
+        RTCMTypeStats* entry = &table[num_types++];
+        memset(entry, 0, sizeof(RTCMTypeStats));
+        entry->message_type = message_type;
+        return entry;
+    }
+
+    RTCMTypeStats table[RTCM_STATS_TYPES];
+    int num_types = 0;
+};
+
+#endif
@@ -32,12 +32,89 @@
       <div class="card">
         <p><i class="fas fa-clock" style="color:#0B67EC;"></i> UP TIME</p><p><span class="reading"><span id="up_time">%UP_TIME%</span> minutes</span></p>
       </div>
+      <div class="card">
+        <p><i class="fas fa-wifi" style="color:#0B67EC;"></i> WIFI OUTAGES / LONGEST (s)</p><p><span class="reading"><span id="wifi_status">%WIFI_STATUS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-stopwatch" style="color:#0B67EC;"></i> BOOT TO WIFI / IP / FIRST CORRECTION (s)</p><p><span class="reading"><span id="boot_timing">%BOOT_TIMING%</span></p>
+      </div>
       <div class="card">
         <p><i class="fas fa-clock" style="color:#0B67EC;"></i> UPLOADS</p><p><span class="reading"><span id="num_uploads">%NUM_UPLOADS%</span></p>
       </div>
+      <div class="card">
+        <p><i class="fas fa-map-marker-alt" style="color:#1EC80D;"></i> SURVEY</p><p><span class="reading"><span id="survey">%SURV_STRING%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-bullseye" style="color:#1EC80D;"></i> SURVEY SIGMA</p><p><span class="reading"><span id="survey_sigma">%SURV_SIGMA%</span> m</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-list-ol" style="color:#1EC80D;"></i> SURVEY SAMPLES</p><p><span class="reading"><span id="survey_samples">%SURV_SAMPLES%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-hourglass-half" style="color:#1EC80D;"></i> TIME TO CONVERGE</p><p><span class="reading"><span id="survey_eta">%SURV_ETA%</span> sec</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-users" style="color:#0B67EC;"></i> CLIENTS</p><p><span class="reading"><span id="num_clients">%NUM_CLIENTS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-list" style="color:#0B67EC;"></i> CLIENT BACKLOG</p><p><span id="client_table">%CLIENT_TABLE%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-filter" style="color:#0B67EC;"></i> SENT / RECEIVED RATE</p><p><span id="filter_table">%FILTER_TABLE%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-layer-group" style="color:#0B67EC;"></i> FRAMES PER WRITE / HOLD</p><p><span id="coalesce">%COALESCE%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-stopwatch" style="color:#0B67EC;"></i> <a href="latency">UART TO SEND P50 / P95 / P99 (ms)</a></p><p><span class="reading"><span id="send_latency">%SEND_LATENCY%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-save" style="color:#0B67EC;"></i> <a href="rtcm_log">RTCM LOG</a></p><p><span id="rtcm_log">%RTCM_LOG%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-cloud-upload-alt" style="color:#0B67EC;"></i> CASTER UPLOAD</p><p><span id="upload_status">%UPLOAD_STATUS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-times" style="color:#FFA533;"></i> BAD FRAMES</p><p><span class="reading"><span id="bad_frames">%BAD_FRAMES%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-trash" style="color:#FFA533;"></i> DROPPED BYTES</p><p><span class="reading"><span id="dropped_bytes">%DROPPED_BYTES%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-exclamation-triangle" style="color:#FFA533;"></i> UART OVERRUNS</p><p><span class="reading"><span id="uart_overruns">%UART_OVERRUNS%</span> bytes</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-water" style="color:#0B67EC;"></i> RING HIGH WATER</p><p><span class="reading"><span id="ring_high_water">%RING_HIGH_WATER%</span> bytes</span></p>
+      </div>
     </div>
+    <h3>RTCM Messages</h3>
+    <table id="rtcm_stats" style="margin: 0 auto; border-collapse: collapse;">
+      <tr><th>Type</th><th>Frames/s</th><th>Bytes/s</th><th>Frames</th><th>Min</th><th>Max</th><th>Jitter (ms) &lt;1 / 2 / 5 / 10 / 20 / 50 / 100 / more</th></tr>
+    </table>
   </div>
 <script>
+function updateRTCMStats()
+{
+  fetch('/rtcm_stats').then(function(response) { return response.json(); }).then(function(stats)
+  {
+    var table = document.getElementById("rtcm_stats");
+    while (table.rows.length > 1)
+    {
+      table.deleteRow(1);
+    }
+    stats.forEach(function(s)
+    {
+      var row = table.insertRow();
+      [s.t, s.fps, s.bps, s.n, s.min, s.max, s.j.join(" / ")].forEach(function(v)
+      {
+        row.insertCell().innerHTML = v;
+      });
+    });
+  });
+}
+updateRTCMStats();
+setInterval(updateRTCMStats, 2000);
+
 if (!!window.EventSource) {
  var source = new EventSource('/events');
  
@@ -54,6 +131,18 @@ if (!!window.EventSource) {
   }
  }, false);
  
+  source.addEventListener('boot_timing', function(e) 
+  {
+    console.log("boot_timing", e.data);
+    document.getElementById("boot_timing").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('wifi_status', function(e) 
+  {
+    console.log("wifi_status", e.data);
+    document.getElementById("wifi_status").innerHTML = e.data;
+  }, false);
+
   source.addEventListener('up_time', function(e) 
   {
     console.log("up_time", e.data);
@@ -65,6 +154,96 @@ if (!!window.EventSource) {
     console.log("num_uploads", e.data);
     document.getElementById("num_uploads").innerHTML = e.data;
   }, false);
+
+  source.addEventListener('survey', function(e) 
+  {
+    console.log("survey", e.data);
+    document.getElementById("survey").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('survey_sigma', function(e) 
+  {
+    console.log("survey_sigma", e.data);
+    document.getElementById("survey_sigma").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('survey_samples', function(e) 
+  {
+    console.log("survey_samples", e.data);
+    document.getElementById("survey_samples").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('survey_eta', function(e) 
+  {
+    console.log("survey_eta", e.data);
+    document.getElementById("survey_eta").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('num_clients', function(e) 
+  {
+    console.log("num_clients", e.data);
+    document.getElementById("num_clients").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('client_table', function(e) 
+  {
+    console.log("client_table", e.data);
+    document.getElementById("client_table").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('filter_table', function(e) 
+  {
+    console.log("filter_table", e.data);
+    document.getElementById("filter_table").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('coalesce', function(e) 
+  {
+    console.log("coalesce", e.data);
+    document.getElementById("coalesce").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('send_latency', function(e) 
+  {
+    console.log("send_latency", e.data);
+    document.getElementById("send_latency").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('rtcm_log', function(e) 
+  {
+    console.log("rtcm_log", e.data);
+    document.getElementById("rtcm_log").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('upload_status', function(e) 
+  {
+    console.log("upload_status", e.data);
+    document.getElementById("upload_status").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('bad_frames', function(e) 
+  {
+    console.log("bad_frames", e.data);
+    document.getElementById("bad_frames").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('dropped_bytes', function(e) 
+  {
+    console.log("dropped_bytes", e.data);
+    document.getElementById("dropped_bytes").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('uart_overruns', function(e) 
+  {
+    console.log("uart_overruns", e.data);
+    document.getElementById("uart_overruns").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('ring_high_water', function(e) 
+  {
+    console.log("ring_high_water", e.data);
+    document.getElementById("ring_high_water").innerHTML = e.data;
+  }, false);
  
 }
 </script>
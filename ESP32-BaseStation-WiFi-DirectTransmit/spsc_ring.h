@@ -0,0 +1,125 @@
+/** SPSC Ring Buffer
+ *  Lock free single producer / single consumer byte ring used to hand UART
+ *  data from the ingest task to the network side of the main loop. Only the
+ *  producer moves the head and only the consumer moves the tail, so no lock
+ *  is needed as long as each side stays on its own task. The time of each
+ *  commit is kept so the consumer can tell when a byte was received.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+
+// Size of the UART ingest ring (bytes, power of two)
+#define SPSC_RING_SIZE 8192
+
+// Number of commit times kept (power of two)
+#define SPSC_RING_MARKS 64
+
+// End position of a commit and the time it was made
+struct SPSCMark
+{
+    uint32_t end;
+    uint32_t time;
+};
+
+class SPSCRing
+{
+  public:
+
+    // Producer: contiguous free space starting at the head, data written
+    // there becomes visible to the consumer after commit()
+    uint8_t* writeBuffer(uint32_t& length)
+    {
+        uint32_t head = head_pos.load(std::memory_order_relaxed);
+        uint32_t tail = tail_pos.load(std::memory_order_acquire);
+        uint32_t index = head % SPSC_RING_SIZE;
+
+        length = SPSC_RING_SIZE - (head - tail);
+        if (length > SPSC_RING_SIZE - index)
+            length = SPSC_RING_SIZE - index;
+        return buffer + index;
+    }
+
+    // Producer: publish bytes written to writeBuffer() and received at time
+    void commit(uint32_t length, uint32_t time)
+    {
+        uint32_t head = head_pos.load(std::memory_order_relaxed) + length;
+
+        uint32_t mark = mark_head.load(std::memory_order_relaxed);
+        marks[mark % SPSC_RING_MARKS] = {head, time};
+        mark_head.store(mark + 1, std::memory_order_release);
+
+        head_pos.store(head, std::memory_order_release);
+
+        uint32_t used = head - tail_pos.load(std::memory_order_relaxed);
+        if (used > high_water)
+            high_water = used;
+    }
+
+    // Consumer: copy up to length bytes out of the ring
+    uint32_t read(uint8_t* data, uint32_t length)
+    {
+        uint32_t tail = tail_pos.load(std::memory_order_relaxed);
+        uint32_t head = head_pos.load(std::memory_order_acquire);
+
+        uint32_t count = head - tail;
+        if (count > length)
+            count = length;
+
+        uint32_t index = tail % SPSC_RING_SIZE;
+        uint32_t first = SPSC_RING_SIZE - index;
+        if (first > count)
+            first = count;
+        memcpy(data, buffer + index, first);
+        memcpy(data + first, buffer, count - first);
+
+        tail_pos.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer: position of the next byte read()
+    uint32_t readPosition() const
+    {
+        return tail_pos.load(std::memory_order_relaxed);
+    }
+
+    // Consumer: time of the commit holding the byte at position, positions
+    // must be asked for in increasing order
+    uint32_t commitTime(uint32_t position)
+    {
+        uint32_t head = mark_head.load(std::memory_order_acquire);
+
+        // The producer ran more than SPSC_RING_MARKS commits ahead
+        if (head - mark_tail > SPSC_RING_MARKS)
+            mark_tail = head - SPSC_RING_MARKS;
+
+        while (mark_tail + 1 < head && (int32_t)(marks[mark_tail % SPSC_RING_MARKS].end - position) <= 0)
+            mark_tail++;
+        return marks[mark_tail % SPSC_RING_MARKS].time;
+    }
+
+    // Bytes waiting for the consumer
+    uint32_t available() const
+    {
+        return head_pos.load(std::memory_order_acquire) - tail_pos.load(std::memory_order_relaxed);
+    }
+
+    // Most bytes held at once since startup
+    volatile uint32_t high_water = 0;
+
+  private:
+
+    uint8_t buffer[SPSC_RING_SIZE];
+    std::atomic<uint32_t> head_pos{0};
+    std::atomic<uint32_t> tail_pos{0};
+
+    SPSCMark marks[SPSC_RING_MARKS];
+    std::atomic<uint32_t> mark_head{0};
+    uint32_t mark_tail = 0;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/** Survey Estimator
+ *  Running mean and covariance of the base station's reported ECEF position
+ *  using Welford's method, updated in constant time for every 1005/1006
+ *  message. The survey is converged once it has run for a minimum time and
+ *  the 3D standard error of the mean is below a fixed limit. Positions a
+ *  second apart are not independent (multipath and atmospheric errors change
+ *  over many seconds), so the error of the mean counts one sample per
+ *  SURVEY_SAMPLE_SPACING rather than every sample. Single outliers
+ *  are ignored, while a lasting jump in the reported position (e.g. the
+ *  receiver finishing its own survey-in) restarts the estimate.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef SURVEY_ESTIMATOR_H
+#define SURVEY_ESTIMATOR_H
+
+// Minimum number of station messages and survey time (ms) before the
+// survey can converge
+#define SURVEY_MIN_SAMPLES 60
+#define SURVEY_MIN_DURATION 300000
+
+// Time between samples that are counted as independent in the error of the
+// mean (ms), a conservative allowance for the correlation of the reported
+// positions
+#define SURVEY_SAMPLE_SPACING 10000
+
+// Max 3D standard error of the mean position for convergence (m)
+#define SURVEY_MAX_SIGMA 0.01
+
+// Distance from the mean that restarts the estimate, in 3D standard
+// deviations, and the floor for that distance (m)
+#define SURVEY_RESET_SIGMAS 6.0
+#define SURVEY_RESET_FLOOR 0.5
+
+// Consecutive samples beyond the reset distance that restart the estimate
+#define SURVEY_RESET_COUNT 3
+
+class SurveyEstimator
+{
+  public:
+
+    // Add a position sample (ECEF, m) received at time_ms
+    void addSample(const double position[3], unsigned long time_ms)
+    {
+        // Ignore messages without a valid position
+        if (fabs(position[0]) + fabs(position[1]) + fabs(position[2]) < 1.0)
+            return;
+
+        if (num_samples > 1)
+        {
+            double distance = 0.0;
+            for (int i = 0; i < 3; i++)
+            {
+                double d = position[i] - reference[i] - mean[i];
+                distance += d * d;
+            }
+            distance = sqrt(distance);
+
+            double limit = SURVEY_RESET_SIGMAS * sigma();
+            if (limit < SURVEY_RESET_FLOOR)
+                limit = SURVEY_RESET_FLOOR;
+            if (distance > limit)
+            {
+                outliers++;
+                if (++consecutive_outliers < SURVEY_RESET_COUNT)
+                    return;
+                reset();
+                restarts++;
+            }
+            consecutive_outliers = 0;
+        }
+
+        // Work relative to the first sample to keep full precision
+        if (num_samples == 0)
+        {
+            for (int i = 0; i < 3; i++)
+                reference[i] = position[i];
+            first_time = time_ms;
+        }
+        last_time = time_ms;
+
+        num_samples++;
+        double delta[3];
+        for (int i = 0; i < 3; i++)
+        {
+            delta[i] = position[i] - reference[i] - mean[i];
+            mean[i] += delta[i] / num_samples;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            double delta_new = position[i] - reference[i] - mean[i];
+            for (int j = 0; j < 3; j++)
+                co_moment[j][i] += delta[j] * delta_new;
+        }
+    }
+
+    // Forget all samples
+    void reset()
+    {
+        num_samples = 0;
+        consecutive_outliers = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            mean[i] = 0.0;
+            for (int j = 0; j < 3; j++)
+                co_moment[i][j] = 0.0;
+        }
+    }
+
+    // Covariance of the samples (m^2)
+    double covariance(int i, int j) const
+    {
+        if (num_samples < 2)
+            return 0.0;
+        return co_moment[i][j] / (num_samples - 1);
+    }
+
+    // 3D standard deviation of the samples (m)
+    double sigma() const
+    {
+        return sqrt(covariance(0,0) + covariance(1,1) + covariance(2,2));
+    }
+
+    // Number of samples counted as independent: one per
+    // SURVEY_SAMPLE_SPACING over the survey, at most every sample
+    double independentSamples() const
+    {
+        double spaced = 1.0 + (double)(last_time - first_time) / SURVEY_SAMPLE_SPACING;
+        return spaced < num_samples ? spaced : (double)num_samples;
+    }
+
+    // 3D standard error of the mean position (m)
+    double meanSigma() const
+    {
+        if (num_samples < 2)
+            return 0.0;
+        return sigma() / sqrt(independentSamples());
+    }
+
+    // Mean ECEF position (m)
+    double meanPosition(int i) const
+    {
+        return reference[i] + mean[i];
+    }
+
+    bool hasPosition() const
+    {
+        return num_samples > 0;
+    }
+
+    bool converged() const
+    {
+        return num_samples >= SURVEY_MIN_SAMPLES && last_time - first_time >= SURVEY_MIN_DURATION &&
+               meanSigma() <= SURVEY_MAX_SIGMA;
+    }
+
+    // Estimated time until convergence (s), assuming the sample spread stays
+    // the same and the error of the mean drops with the square root of the
+    // number of independent samples. Returns -1 while there is too little
+    // data.
+    double timeToConverge() const
+    {
+        if (converged())
+            return 0.0;
+        if (num_samples < 2 || last_time == first_time)
+            return -1.0;
+
+        double elapsed = (last_time - first_time) / 1000.0;
+        double sample_period = elapsed / (num_samples - 1);
+        double spacing = SURVEY_SAMPLE_SPACING / 1000.0;
+        if (spacing < sample_period)
+            spacing = sample_period;
+
+        double s = sigma() / SURVEY_MAX_SIGMA;
+        double duration = (s * s - 1.0) * spacing;
+        if (duration < SURVEY_MIN_DURATION / 1000.0)
+            duration = SURVEY_MIN_DURATION / 1000.0;
+        if (duration < (SURVEY_MIN_SAMPLES - 1) * sample_period)
+            duration = (SURVEY_MIN_SAMPLES - 1) * sample_period;
+
+        return duration - elapsed;
+    }
+
+    unsigned long num_samples = 0;
+    unsigned long restarts = 0;
+    unsigned long outliers = 0;
+
+  private:
+
+    int consecutive_outliers = 0;
+    double reference[3] = {0.0, 0.0, 0.0};
+    double mean[3] = {0.0, 0.0, 0.0};
+    double co_moment[3][3] = {{0.0}};
+    unsigned long first_time = 0;
+    unsigned long last_time = 0;
+};
+
+#endif
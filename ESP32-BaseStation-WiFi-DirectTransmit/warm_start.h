@@ -0,0 +1,140 @@
+/** Warm Start Cache
+ *  Keeps the latest station reference, antenna and GLONASS bias frames plus
+ *  the most recent complete MSM epoch so they can be sent to a rover as soon
+ *  as it connects, instead of the rover waiting for the next occurrence of
+ *  each message. The cached frames are published as one snapshot at the end
+ *  of every epoch. Two snapshots are kept so that a new one can be published
+ *  while clients are still reading the last, a client keeps the snapshot it
+ *  started with and never receives a mix of two. Publishing is only skipped
+ *  while both are being read, and the sketch closes clients that take longer
+ *  than WARM_START_TIMEOUT so a stalled client cannot hold one for long.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef WARM_START_H
+#define WARM_START_H
+
+// Largest station/antenna/bias frame kept (bytes)
+#define WARM_SLOT_SIZE 256
+
+// Largest MSM epoch kept (bytes)
+#define WARM_EPOCH_SIZE 4096
+
+// Message types kept, one frame each
+const uint16_t warm_start_types[] = {1005, 1006, 1007, 1008, 1033, 1230};
+#define NUM_WARM_SLOTS (sizeof(warm_start_types) / sizeof(warm_start_types[0]))
+
+#define WARM_SNAPSHOT_SIZE (NUM_WARM_SLOTS * WARM_SLOT_SIZE + WARM_EPOCH_SIZE)
+
+// Longest time a client may take to read a snapshot (ms)
+#define WARM_START_TIMEOUT 5000
+
+class WarmStartCache
+{
+  public:
+
+    // Add a validated frame, msm is set for observation messages and
+    // end_of_epoch for the last MSM frame of an epoch
+    void add(const uint8_t* frame, uint16_t length, uint16_t message_type,
+             bool msm, bool end_of_epoch)
+    {
+        if (msm)
+        {
+            // First MSM frame of a new epoch
+            if (!epoch_open)
+            {
+                epoch_open = true;
+                epoch_valid = true;
+                epoch_length = 0;
+            }
+
+            if (epoch_length + length <= WARM_EPOCH_SIZE)
+            {
+                memcpy(epoch + epoch_length, frame, length);
+                epoch_length += length;
+            }
+            else
+            {
+                epoch_valid = false;
+            }
+
+            if (end_of_epoch)
+            {
+                epoch_open = false;
+                if (epoch_valid)
+                    publish();
+            }
+            return;
+        }
+
+        for (unsigned int i = 0; i < NUM_WARM_SLOTS; i++)
+        {
+            if (warm_start_types[i] == message_type && length <= WARM_SLOT_SIZE)
+            {
+                memcpy(slots[i], frame, length);
+                slot_length[i] = length;
+                return;
+            }
+        }
+    }
+
+    // A client starts reading the latest snapshot, returns the snapshot
+    // to read, and finishes with it
+    uint8_t acquire()
+    {
+        readers[current]++;
+        return current;
+    }
+    void release(uint8_t index) { if (readers[index] > 0) readers[index]--; }
+
+    const uint8_t* data(uint8_t index) const { return snapshot[index]; }
+    uint16_t length(uint8_t index) const { return snapshot_length[index]; }
+
+    // Snapshots published and skipped because both were being read
+    unsigned long published = 0;
+    unsigned long skipped = 0;
+
+  private:
+
+    // Copy the station frames and the completed epoch into the snapshot
+    // that is not being read and make it the latest
+    void publish()
+    {
+        uint8_t next = readers[current] > 0 ? current ^ 1 : current;
+        if (readers[next] > 0)
+        {
+            skipped++;
+            return;
+        }
+
+        uint8_t* out = snapshot[next];
+        uint16_t length = 0;
+        for (unsigned int i = 0; i < NUM_WARM_SLOTS; i++)
+        {
+            memcpy(out + length, slots[i], slot_length[i]);
+            length += slot_length[i];
+        }
+        memcpy(out + length, epoch, epoch_length);
+        length += epoch_length;
+
+        snapshot_length[next] = length;
+        current = next;
+        published++;
+    }
+
+    uint8_t slots[NUM_WARM_SLOTS][WARM_SLOT_SIZE];
+    uint16_t slot_length[NUM_WARM_SLOTS] = {0};
+
+    uint8_t epoch[WARM_EPOCH_SIZE];
+    uint16_t epoch_length = 0;
+    bool epoch_open = false;
+    bool epoch_valid = false;
+
+    uint8_t snapshot[2][WARM_SNAPSHOT_SIZE];
+    uint16_t snapshot_length[2] = {0, 0};
+    int readers[2] = {0, 0};
+    uint8_t current = 0;
+};
+
+#endif
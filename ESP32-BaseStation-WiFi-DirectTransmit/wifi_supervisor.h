@@ -0,0 +1,278 @@
+/** WiFi Supervisor
+ *  Keeps the station connected to the access point without blocking loop().
+ *  Link changes are reported by WiFi events, service() is called from loop()
+ *  to ask the access point again every WIFI_RECONNECT_PERIOD while the link
+ *  is down, so the UART and correction pipelines keep running through an
+ *  outage. The ESP32 is only restarted if an outage lasts longer than the
+ *  grace period set in inputs.h. Outage counts and durations are kept for
+ *  the web page.
+ *  The BSSID, channel and address lease of the last good connection are
+ *  saved in NVS. Later connections go straight to that access point
+ *  without scanning, and can skip DHCP with a static address or by reusing
+ *  the saved lease. A failed fast attempt falls back to a full scan and
+ *  DHCP. Times from boot to the link, the address and the first correction
+ *  are kept to show the gain.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef WIFI_SUPERVISOR_H
+#define WIFI_SUPERVISOR_H
+
+#include <WiFi.h>
+#include <esp_task_wdt.h>
+#include <Preferences.h>
+
+// Time between reconnect requests while the link is down (ms)
+#define WIFI_RECONNECT_PERIOD 5000
+
+// Last good connection, saved in NVS
+struct WiFiCache
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+class WiFiSupervisor
+{
+  public:
+
+    // Use a fixed address instead of DHCP, call before begin()
+    void setStaticIP(IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns)
+    {
+        static_ip = true;
+        fixed = {{0}, 0, (uint32_t)ip, (uint32_t)gateway, (uint32_t)subnet, (uint32_t)dns};
+    }
+
+    // Start connecting, grace_period (ms) is the longest outage before a
+    // restart, 0 never restarts. fast_connect skips the scan when an access
+    // point is saved and reuse_lease also skips DHCP.
+    void begin(const char* network, const char* key, unsigned long grace_period,
+               bool fast_connect, bool reuse_lease)
+    {
+        ssid = network;
+        password = key;
+        grace = grace_period;
+        fast = fast_connect;
+        reuse = reuse_lease;
+
+        preferences.begin("wifi", false);
+        cache_valid = preferences.getBytes("cache", &cache, sizeof(cache)) == sizeof(cache);
+
+        // Events arrive on the WiFi task, only flags are set there
+        WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info)
+        {
+            if (event == ARDUINO_EVENT_WIFI_STA_CONNECTED)
+            {
+                if (link_time == 0)
+                    link_time = millis();
+            }
+            else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+            {
+                if (address_time == 0)
+                    address_time = millis();
+                link_up = true;
+            }
+            else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
+            {
+                link_up = false;
+                disconnect_reason = info.wifi_sta_disconnected.reason;
+            }
+        });
+
+        WiFi.mode(WIFI_STA);
+        WiFi.setAutoReconnect(false);
+        down_since = millis();
+        connect();
+    }
+
+    // Wait for the first connection at startup, restarting after the grace
+    // period
+    void waitForConnection()
+    {
+        while (!link_up)
+        {
+            esp_task_wdt_reset();
+            if (grace > 0 && millis() - down_since > grace)
+                ESP.restart();
+            if (millis() - last_request > WIFI_RECONNECT_PERIOD)
+                reconnect();
+            Serial.print('.');
+            delay(250);
+        }
+        service();
+    }
+
+    // Track link changes and ask for a reconnect while the link is down,
+    // call from loop()
+    void service()
+    {
+        bool up = link_up;
+        if (up && !connected)
+        {
+            connected = true;
+            unsigned long outage = millis() - down_since;
+            if (outages > 0)
+            {
+                last_outage = outage;
+                total_outage += outage;
+                if (outage > longest_outage)
+                    longest_outage = outage;
+            }
+            fast_failed = false;
+            saveCache();
+            Serial.print(" IP Address: ");Serial.println(WiFi.localIP());
+            Serial.print(fast_attempt ? "Fast connect" : "Connected after scan");
+            Serial.print(" in ");Serial.print(outage);Serial.println(" ms");
+            Serial.print("The MAC address for this board is: ");Serial.println(WiFi.macAddress());
+        }
+        else if (!up && connected)
+        {
+            connected = false;
+            outages++;
+            down_since = millis();
+            Serial.print(millis());Serial.print(" WiFi lost, reason ");Serial.println(disconnect_reason);
+
+            // First attempt goes straight back to the saved access point
+            connect();
+        }
+
+        if (connected)
+            return;
+
+        if (grace > 0 && millis() - down_since > grace)
+        {
+            Serial.println("WiFi outage longer than grace period, restarting");
+            ESP.restart();
+        }
+        if (millis() - last_request > WIFI_RECONNECT_PERIOD)
+            reconnect();
+    }
+
+    bool isConnected() const { return connected; }
+
+    // Length of the current outage (ms), 0 while connected
+    unsigned long outageTime() const { return connected ? 0 : millis() - down_since; }
+
+    // Note the first correction sent or received, once
+    void firstCorrection()
+    {
+        if (first_correction_time == 0)
+        {
+            first_correction_time = millis();
+            Serial.print("First correction ");Serial.print(first_correction_time);Serial.println(" ms after boot");
+        }
+    }
+
+    // Times from boot to the WiFi link, the address and the first
+    // correction (s) for the web page
+    String bootTiming() const
+    {
+        return timeText(link_time) + " / " + timeText(address_time) + " / " +
+               timeText(first_correction_time);
+    }
+
+    // Outages / longest outage (s) for the web page
+    String status() const
+    {
+        if (!connected)
+            return "Down " + String(outageTime() / 1000) + " s";
+        return String(outages) + " / " + String(longest_outage / 1000.0, 1);
+    }
+
+    // Statistics
+    unsigned long outages = 0;
+    unsigned long last_outage = 0;
+    unsigned long longest_outage = 0;
+    unsigned long total_outage = 0;
+
+  private:
+
+    // Ask the access point again, returns straight away. A fast attempt
+    // that did not connect is followed by a full scan and DHCP.
+    void reconnect()
+    {
+        if (fast_attempt)
+            fast_failed = true;
+        WiFi.disconnect();
+        connect();
+    }
+
+    // Start connecting with the saved access point and address when they
+    // can be used
+    void connect()
+    {
+        bool use_cache = fast && cache_valid && !fast_failed;
+
+        if (static_ip)
+            WiFi.config(fixed.ip, fixed.gateway, fixed.subnet, fixed.dns);
+        else if (use_cache && reuse && cache.ip != 0)
+            WiFi.config(cache.ip, cache.gateway, cache.subnet, cache.dns);
+        else
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+
+        if (use_cache)
+            WiFi.begin(ssid, password, cache.channel, cache.bssid);
+        else
+            WiFi.begin(ssid, password);
+
+        fast_attempt = use_cache;
+        last_request = millis();
+    }
+
+    // Save the current access point and lease, flash is only written when
+    // they change
+    void saveCache()
+    {
+        WiFiCache current;
+        memset(&current, 0, sizeof(current));
+        memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+        current.channel = WiFi.channel();
+        current.ip = WiFi.localIP();
+        current.gateway = WiFi.gatewayIP();
+        current.subnet = WiFi.subnetMask();
+        current.dns = WiFi.dnsIP();
+
+        if (cache_valid && memcmp(&current, &cache, sizeof(cache)) == 0)
+            return;
+        cache = current;
+        cache_valid = true;
+        preferences.putBytes("cache", &cache, sizeof(cache));
+    }
+
+    static String timeText(unsigned long time)
+    {
+        return time == 0 ? String("-") : String(time / 1000.0, 2);
+    }
+
+    const char* ssid = "";
+    const char* password = "";
+    unsigned long grace = 0;
+
+    Preferences preferences;
+    WiFiCache cache;
+    WiFiCache fixed;
+    bool cache_valid = false;
+    bool static_ip = false;
+    bool fast = false;
+    bool reuse = false;
+    bool fast_attempt = false;
+    bool fast_failed = false;
+
+    // Boot timing (ms), 0 until reached
+    volatile unsigned long link_time = 0;
+    volatile unsigned long address_time = 0;
+    unsigned long first_correction_time = 0;
+
+    volatile bool link_up = false;
+    volatile uint8_t disconnect_reason = 0;
+    bool connected = false;
+    unsigned long down_since = 0;
+    unsigned long last_request = 0;
+};
+
+#endif
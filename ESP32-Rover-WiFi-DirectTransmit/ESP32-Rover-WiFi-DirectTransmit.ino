@@ -22,7 +22,8 @@
  * Firmware for ESP32 running on the rover with correction data sent directly over WiFi network.
  * This firmware connects to a WiFi network and to the base station via TCP (modify inputs.h for your settings).
  * The base station provides correction data that is then forwarded to the GNSS processor
- * to compute an RTK solution.
+ * to compute an RTK solution. Corrections can instead be received from any NTRIP caster, including
+ * the one run by the base station.
  * This firmware also displays information about the RTK solution and data used on a webpage,
  * which is available on the ESP32's IP address (printed to serial at startup).
  */
@@ -30,6 +31,7 @@
 // Libraries
 #include <map>
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <TinyGPS++.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
@@ -46,6 +48,15 @@
 #include "rtk.h"
 #include "map.h"
 #include "gnss.h"
+#include "rtcm_framer.h"
+#include "correction_udp.h"
+#include "ntrip_client.h"
+#include "latency.h"
+#include "uart_tx_ring.h"
+#include "tcp_connect.h"
+#include "wifi_supervisor.h"
+#include "discovery.h"
+#include "correction_source.h"
 
 // ESP32 watch dog timer (s)
 #define WDT_TIMEOUT 10
@@ -56,14 +67,74 @@ AsyncWebServer server(80);
 // Create an Event Source on /events
 AsyncEventSource events("/events");
 
+// WiFi link kept up from loop(), see wifi_restart_grace in inputs.h
+WiFiSupervisor wifi_supervisor;
+
 // Communications port to other ESP32
 #define COM_PORT 4081
 
-// TCP client for connecting to base station ESP32
-WiFiClient tcp_client;
+// Correction sources, the primary set up from inputs.h and an optional hot
+// standby, see standby_enabled. TCP sources are connected from loop()
+// without blocking and each has its own framer, only frames from the active
+// source reach the receiver.
+#define PRIMARY_SOURCE 0
+#define STANDBY_SOURCE 1
+CorrectionSource sources[MAX_SOURCES];
+SourceSelector selector;
+uint8_t num_sources = 1;
+
+// Base station found from its discovery beacon, see base_discovery in
+// inputs.h
+WiFiUDP discovery_udp;
+BaseBeacon base_beacon;
+IPAddress discovered_address;
+unsigned long next_probe = 0;
+
+// Corrections are read from the socket in blocks of up to one TCP segment
+#define TCP_READ_SIZE 1460
+uint8_t tcp_data[TCP_READ_SIZE];
+
+// UART ring space kept free beyond a block: a partly received frame, and
+// the cached station frame written ahead of it after a source switch
+#define UART_TX_RESERVE (2 * RTCM_MAX_FRAME_LENGTH)
+
+// Optional UDP transport, see udp_enabled in inputs.h
+#define UDP_PORT 4082
+WiFiUDP correction_udp;
+UDPSequenceTracker udp_tracker;
+UDPParityDecoder udp_fec;
+
+// Correction latency from the base UART to the Serial1 write, measured
+// against the base clock
+WiFiUDP time_sync_udp;
+ClockSync clock_sync;
+LatencyHistogram correction_latency;
+IPAddress base_address;
+unsigned long next_time_sync = 0;
+#define TIME_SYNC_PERIOD 2000
+
+// A frame's latency is recorded when its last byte leaves the UART ring
+#define LATENCY_PENDING 8
+struct PendingLatency
+{
+    uint32_t end;
+    uint32_t ingest_time;
+};
+PendingLatency pending_latency[LATENCY_PENDING];
+uint8_t pending_head = 0;
+uint8_t pending_tail = 0;
+uint32_t last_write_end = 0;
+bool last_write_pending = false;
+
+// Checked RTCM frames are passed to the GNSS receiver through the UART
+// ring
+UARTTxRing uart_tx;
 
-// Max length of an RTCM data burst
-#define MAX_SERIAL_LENGTH 2500
+// Wait before asking a caster again after it refused the request (ms)
+#define NTRIP_REFUSED_RETRY 30000
+
+// Latest GGA sentence from the GNSS receiver, uploaded to VRS casters
+char last_gga[NTRIP_MAX_GGA + 1] = "";
 
 #define NEO_PIN 4
 Adafruit_NeoPixel pixels(1, NEO_PIN, NEO_GRB + NEO_KHZ800);
@@ -148,9 +219,6 @@ TinyGPSCustom bei_snr[4];
 // Library and structure for transfering data from RP2040 processor
 SerialTransfer transferFromNav;
 
-unsigned long next_connection_attempt = 0;
-int connection_attempt_period = 1000;
-
 struct STRUCT
 {
     float voltage;
@@ -188,15 +256,77 @@ void setup()
     pixels.show();
 
     // Connect to WiFi network
-    connectWiFi();
+    Serial.print("Connecting to WiFi .");
+    if (wifi_static_ip)
+    {
+        wifi_supervisor.setStaticIP(wifi_ip, wifi_gateway, wifi_subnet, wifi_dns);
+    }
+    wifi_supervisor.begin(ssid, password, wifi_restart_grace * 1000UL, wifi_fast_connect, wifi_reuse_lease);
+    wifi_supervisor.waitForConnection();
 
     // Software serial connection to RP2040
     tinkernav_serial.begin(57600, SWSERIAL_8N1, 0, 1);
     transferFromNav.begin(tinkernav_serial);
 
+    // RTCM frame validation
+    crc24qInit();
+
     // GNSS hardware serial connection
     Serial1.begin(115200, SERIAL_8N1, 21, 20);
 
+    // Clock replies from the base station
+    time_sync_udp.begin(TIME_SYNC_PORT);
+
+    // Listen for UDP corrections from the base station
+    if (udp_enabled)
+    {
+        sources[PRIMARY_SOURCE].begin(SOURCE_UDP, "Primary");
+        if (udp_address[0] >= 224 && udp_address[0] <= 239)
+        {
+            correction_udp.beginMulticast(udp_address, UDP_PORT);
+        }
+        else
+        {
+            correction_udp.begin(UDP_PORT);
+        }
+    }
+    // The first TCP connections are made from loop()
+    else if (ntrip_enabled)
+    {
+        sources[PRIMARY_SOURCE].begin(SOURCE_NTRIP, "Primary");
+        sources[PRIMARY_SOURCE].setNtrip(ntrip_host, ntrip_mountpoint, ntrip_user, ntrip_password, ntrip_v2);
+        sources[PRIMARY_SOURCE].connector.begin(ntrip_host, ntrip_port);
+    }
+    else
+    {
+        sources[PRIMARY_SOURCE].begin(SOURCE_BASE, "Primary");
+        sources[PRIMARY_SOURCE].connector.begin(serverAddress, COM_PORT);
+    }
+
+    // Hot standby, a second base station or a caster
+    if (standby_enabled)
+    {
+        CorrectionSource& standby = sources[STANDBY_SOURCE];
+        if (standby_mountpoint[0] != '\0')
+        {
+            standby.begin(SOURCE_NTRIP, "Standby");
+            standby.setNtrip(standby_host, standby_mountpoint, standby_user, standby_password, standby_v2);
+        }
+        else
+        {
+            standby.begin(SOURCE_BASE, "Standby");
+        }
+        standby.connector.begin(standby_host, standby_port);
+        num_sources = 2;
+    }
+    selector.begin(sources, num_sources);
+
+    // Beacons and probe replies from the base station
+    if (base_discovery && !udp_enabled && !ntrip_enabled)
+    {
+        discovery_udp.begin(DISCOVERY_PORT);
+    }
+
     // Initialize TinyGPSCustom objects for GPGSV messages
     for (int i=0; i<4; ++i)
     {
@@ -285,6 +415,45 @@ void setup()
       request->send_P(200, "text/plain", lat_lng);
     });
 
+    // Correction latency from the base UART to the receiver UART (ms)
+    server.on("/latency", HTTP_GET, [](AsyncWebServerRequest *request)
+    {
+        char sync[80];
+        snprintf(sync, sizeof(sync), ",\"synced\":%s,\"offset_us\":%ld,\"rtt_us\":%lu",
+                 clock_sync.synced ? "true" : "false", (long)clock_sync.offset,
+                 (unsigned long)clock_sync.best_round_trip);
+        char json[256];
+        correction_latency.toJSON(json, sizeof(json), sync);
+        request->send(200, "application/json", json);
+    });
+
+    // Correction source scores, use and switch-over gaps
+    server.on("/sources", HTTP_GET, [](AsyncWebServerRequest *request)
+    {
+        unsigned long now = millis();
+        String json = "{\"active\":\"" + String(sources[selector.active].name) +
+                      "\",\"switches\":" + String(selector.switches) +
+                      ",\"last_gap_ms\":" + String(selector.last_gap) +
+                      ",\"max_gap_ms\":" + String(selector.max_gap) +
+                      ",\"dropped_bytes\":" + String(bytesDiscarded()) +
+                      ",\"dropped_frames\":" + String(uart_tx.frames_dropped) + ",\"sources\":[";
+        for (uint8_t i = 0; i < num_sources; i++)
+        {
+            CorrectionSource& source = sources[i];
+            json += String(i == 0 ? "" : ",") + "{\"name\":\"" + source.name +
+                    "\",\"usable\":" + (source.usable(now) ? "true" : "false") +
+                    ",\"score\":" + String(source.score(now, lattitude, longitude), 0) +
+                    ",\"lateness_ms\":" + String(source.lateness, 0) +
+                    ",\"age_ms\":" + String(source.frames > 0 ? now - source.last_frame_time : 0) +
+                    ",\"baseline_km\":" + String(source.baseline(lattitude, longitude), 2) +
+                    ",\"frames\":" + String(source.frames) +
+                    ",\"forwarded\":" + String(source.frames_forwarded) +
+                    ",\"active_s\":" + String(selector.activeTime(i) / 1000) + "}";
+        }
+        json += "]}";
+        request->send(200, "application/json", json);
+    });
+
     // Table of detected satellites
     server.on("/sat_table",  HTTP_GET, [](AsyncWebServerRequest *request)
     {
@@ -384,6 +553,9 @@ void loop()
     // so that the hardware doesn't reset
     esp_task_wdt_reset();
 
+    // Track the WiFi link and reconnect in the background
+    wifi_supervisor.service();
+
     // Receive serial data from TinkerCharge via RP2040
     if (transferFromNav.available())
     {
@@ -394,28 +566,34 @@ void loop()
     // Read and parse latest data from GNSS receiver
     readAndParseGNSS();
 
-    // If not connected to TCP client and timeout has expired, attempt to connect
-    if (!tcp_client.connected() && millis() > next_connection_attempt) 
-    {
-        // Connect to TCP server
-        connectToServer();
+    // Follow the base station's beacon to its current address
+    discoverBase();
 
-        next_connection_attempt = millis() + connection_attempt_period;
+    // Read corrections sent by UDP
+    if (udp_enabled)
+    {
+        readAndSendUDPData();
     }
 
-    // Read data from TCP server if it is connected
-    if (tcp_client.connected())
+    // Connect the TCP sources without blocking the loop and read their data
+    for (uint8_t i = 0; i < num_sources; i++)
     {
-        readAndSendTCPData();
+        serviceSource(i);
     }
 
+    // Choose the best source, the switch itself happens between frames
+    selector.update(lattitude, longitude, millis());
+
+    // Pass queued corrections to the GNSS receiver as the UART has room
+    drainCorrections();
+
+    // Keep the clock offset to the base station current
+    syncClock();
+
     // Update webpages
     if (millis() > next_update) 
     {
 
-        // Check connection to WiFi and reconnect if needed
-        connectWiFi();
- 
         // Send Events to update webpages
         events.send("ping",NULL,millis());
         events.send(String(data_for_tinker_send.voltage).c_str(),"voltage",millis());
@@ -426,6 +604,8 @@ void loop()
         events.send(String(data_for_tinker_send.SOC).c_str(),"battery_soc",millis());
         events.send(String(data_for_tinker_send.temperature).c_str(),"tc_temp",millis());
         events.send(String(millis()/1000.0/60.0).c_str(),"up_time",millis());
+        events.send(wifi_supervisor.status().c_str(),"wifi_status",millis());
+        events.send(wifi_supervisor.bootTiming().c_str(),"boot_timing",millis());
         
         events.send(String(lattitude).c_str(),"lat",millis());
         events.send(String(longitude).c_str(),"lng",millis());
@@ -442,105 +622,557 @@ void loop()
         events.send(String(rtk_east).c_str(),"rtk_east",millis());
         events.send(String(rtk_north).c_str(),"rtk_north",millis());
         events.send(String(rtk_up).c_str(),"rtk_up",millis());
+        events.send(String(framesFailed()).c_str(),"bad_frames",millis());
+        events.send(String(bytesDiscarded()).c_str(),"dropped_bytes",millis());
+        events.send(String(uart_tx.frames_dropped).c_str(),"dropped_frames",millis());
+        events.send(String(resyncs()).c_str(),"resyncs",millis());
+        events.send(String(udp_tracker.lost).c_str(),"udp_lost",millis());
+        events.send(String(udp_tracker.reordered).c_str(),"udp_reordered",millis());
+        events.send(String(udp_fec.recovered).c_str(),"fec_recovered",millis());
+        events.send(String(udp_fec.unrecoverable).c_str(),"fec_failed",millis());
+        events.send(ntripStatus().c_str(),"ntrip_status",millis());
+        events.send(linkStatus().c_str(),"link_status",millis());
+        events.send(baseStatus().c_str(),"base_status",millis());
+        events.send(selector.status().c_str(),"source_status",millis());
+        events.send(correction_latency.summary().c_str(),"latency",millis());
 
         next_update = millis() + update_period;
 
     }
 }
 
-// Connect to TCP server on base station
-void connectToServer()
+// Connect a TCP source, read its corrections and report the rover position
+// to its caster
+void serviceSource(uint8_t index)
 {
-    int attempt_count = 0;
-    
-    Serial.print("Connecting to TCP Server ... ");
-    while (!tcp_client.connect(serverAddress, COM_PORT) && attempt_count < 50) 
+
+    CorrectionSource& source = sources[index];
+    if (source.type == SOURCE_UDP)
     {
-      Serial.print(".");
-      attempt_count++;
-      delay(100);
+        return;
     }
-    
-    Serial.println("");
 
-    if (tcp_client.connected())
+    // Connect or reconnect to the TCP server without blocking the loop
+    if (source.connector.service(source.client))
     {
-        Serial.println("Connected to TCP server");
+        startStream(source);
     }
-    else
+
+    if (!source.client.connected())
     {
-        Serial.println("TCP Server Connection Failed");
+        return;
     }
 
+    if (index == selector.active)
+    {
+        followBase(source.client.remoteIP());
+    }
+    readSource(index);
+
+    if (source.type == SOURCE_NTRIP && source.ntrip.streaming())
+    {
+        sendGGA(source);
+    }
 }
 
-// Read RTCM correction data from the TCP sever on the base station and send it
-// to the local PX1125R GNSS receiver so it can compute an RTK solution
-void readAndSendTCPData()
+// Start using a new connection to the TCP server on a base station, or
+// request the mountpoint from the NTRIP caster
+void startStream(CorrectionSource& source)
 {
-    unsigned long i = 0;
-    bool data_read = false;
-    char rtcm_data[MAX_SERIAL_LENGTH];
-    
-    // If serial data is still available on TCP server
-    while (tcp_client.available())
+
+    Serial.print(source.name);Serial.print(" connected to TCP server after ");
+    Serial.print(source.connector.last_reconnect_time);Serial.println(" ms");
+
+    // A frame cut off by the last disconnect can never be completed,
+    // only whole frames reach the receiver
+    source.restart();
+
+    if (source.type == SOURCE_NTRIP)
+    {
+        source.ntrip.reset();
+        source.client.print(ntripRequest(source.host, source.mountpoint, source.user,
+                                         source.password, source.v2, last_gga));
+        source.next_gga_upload = millis() + ntrip_gga_period;
+        Serial.print("Requested NTRIP mountpoint ");Serial.println(source.mountpoint);
+    }
+}
+
+// Time requests go to the base station of the active source, the clock
+// offset is measured again when that changes
+void followBase(IPAddress address)
+{
+    if (address == base_address)
+    {
+        return;
+    }
+    base_address = address;
+    clock_sync = ClockSync();
+    next_time_sync = 0;
+}
+
+// Read base station beacons and probe for the base while it is not
+// connected, the connection follows the base to a new address
+void discoverBase()
+{
+
+    if (!base_discovery || ntrip_enabled || udp_enabled)
+    {
+        return;
+    }
+
+    uint8_t data[DISCOVERY_BEACON_LENGTH];
+    while (discovery_udp.parsePacket() > 0)
+    {
+        int length = discovery_udp.read(data, sizeof(data));
+        BaseBeacon beacon;
+        if (!unpackBeacon(data, length, beacon) || strcmp(beacon.name, base_name) != 0)
+        {
+            continue;
+        }
+
+        // The standby base station keeps its own address. standby_host may
+        // be a name, the standby connection looks it up and the beacon is
+        // not compared with it until it has been found.
+        if (standby_enabled)
+        {
+            IPAddress standby_address = sources[STANDBY_SOURCE].connector.serverAddress();
+            if (standby_address != IPAddress(0, 0, 0, 0) && discovery_udp.remoteIP() == standby_address)
+            {
+                continue;
+            }
+        }
+
+        base_beacon = beacon;
+        if (discovered_address != discovery_udp.remoteIP())
+        {
+            discovered_address = discovery_udp.remoteIP();
+            Serial.print(millis());Serial.print(" Base station found at ");Serial.println(discovered_address);
+        }
+
+        // A connected stream is left alone, it follows the beacon once it
+        // drops
+        if (!sources[PRIMARY_SOURCE].client.connected())
+        {
+            sources[PRIMARY_SOURCE].connector.setServer(discovered_address, base_beacon.tcp_port);
+        }
+    }
+
+    // A probe gets an answer straight away instead of waiting for the
+    // next beacon
+    if (!sources[PRIMARY_SOURCE].client.connected() && millis() >= next_probe)
+    {
+        discovery_udp.beginPacket(IPAddress(255, 255, 255, 255), DISCOVERY_PORT);
+        discovery_udp.write(data, packProbe(data));
+        discovery_udp.endPacket();
+        next_probe = millis() + DISCOVERY_PROBE_PERIOD;
+    }
+}
+
+// Text for the base station card: address and client slots in use
+String baseStatus()
+{
+    if (ntrip_enabled)
+    {
+        return String(ntrip_host);
+    }
+    if (udp_enabled)
+    {
+        return "UDP " + udp_address.toString();
+    }
+    if (!base_discovery)
+    {
+        return serverAddress.toString();
+    }
+    if (discovered_address == IPAddress(0, 0, 0, 0))
+    {
+        return "Searching";
+    }
+    return discovered_address.toString() + " (" + String(base_beacon.clients) + "/" +
+           String(base_beacon.max_clients) + ")";
+}
+
+// Text for the TCP link card: attempts / connects / last reconnect time
+// of the active source
+String linkStatus()
+{
+    const CorrectionSource& source = sources[selector.active];
+    if (source.type == SOURCE_UDP)
+    {
+        return "UDP";
+    }
+    return String(source.connector.attempts) + " / " + String(source.connector.connects) + " / " +
+           String(source.connector.last_reconnect_time / 1000.0, 1);
+}
+
+// Upload the latest GGA sentence to the caster every ntrip_gga_period
+void sendGGA(CorrectionSource& source)
+{
+    if (ntrip_gga_period == 0 || last_gga[0] == '\0' || millis() < source.next_gga_upload)
+    {
+        return;
+    }
+
+    source.client.print(last_gga);
+    source.next_gga_upload = millis() + ntrip_gga_period;
+}
+
+// Text for the NTRIP status card, the active source if it is a caster
+String ntripStatus()
+{
+    if (sources[selector.active].type == SOURCE_NTRIP)
+    {
+        return sourceNtripStatus(sources[selector.active]);
+    }
+    for (uint8_t i = 0; i < num_sources; i++)
+    {
+        if (sources[i].type == SOURCE_NTRIP)
+        {
+            return sourceNtripStatus(sources[i]);
+        }
+    }
+    return "Off";
+}
+
+String sourceNtripStatus(CorrectionSource& source)
+{
+    if (source.ntrip.error == NTRIP_UNAUTHORIZED)
+    {
+        return "Unauthorized";
+    }
+    if (source.ntrip.error == NTRIP_NOT_FOUND)
+    {
+        return "No mountpoint";
+    }
+    if (source.ntrip.error == NTRIP_BAD_RESPONSE)
+    {
+        return "Bad response";
+    }
+    if (!source.client.connected())
+    {
+        return "Disconnected";
+    }
+    if (source.ntrip.streaming())
+    {
+        return "Streaming v" + String(source.ntrip.version);
+    }
+    return "Connecting";
+}
+
+// Frame checking counts summed over the sources for the web page
+unsigned long framesFailed()
+{
+    unsigned long total = 0;
+    for (uint8_t i = 0; i < num_sources; i++)
+    {
+        total += sources[i].framer.frames_failed;
+    }
+    return total;
+}
+
+unsigned long bytesDiscarded()
+{
+    unsigned long total = 0;
+    for (uint8_t i = 0; i < num_sources; i++)
+    {
+        total += sources[i].framer.bytes_discarded;
+    }
+    return total;
+}
+
+unsigned long resyncs()
+{
+    unsigned long total = 0;
+    for (uint8_t i = 0; i < num_sources; i++)
     {
-        // Read data from serial
-        rtcm_data[i] = tcp_client.read();
-        i++;
-        data_read = true;     
+        total += sources[i].framer.resyncs;
+    }
+    return total;
+}
 
-        // Ensure the char array is not overfilled
-        if (i >= MAX_SERIAL_LENGTH)
+// Read RTCM correction data from a TCP source and send it to the local
+// PX1125R GNSS receiver so it can compute an RTK solution. Only complete
+// frames with a valid CRC are passed on, and only from the active source.
+void readSource(uint8_t index)
+{
+    CorrectionSource& source = sources[index];
+    unsigned long total = 0;
+
+    // Read whole blocks while there is data, each block can complete
+    // frames with at most its own length plus a partly received frame and
+    // a station frame
+    while (source.client.available() > 0 && uart_tx.space() > UART_TX_RESERVE)
+    {
+        // Data left in the socket when the UART falls behind slows the
+        // sender through TCP flow control
+        uint32_t space = uart_tx.space() - UART_TX_RESERVE;
+        int count = source.client.read(tcp_data, space < TCP_READ_SIZE ? space : TCP_READ_SIZE);
+        if (count <= 0)
         {
-            Serial.println("!!!More TCP data than space in char array");
             break;
         }
+        total += count;
+
+        // NTRIP response headers and chunk framing are not correction data
+        uint32_t length = count;
+        if (source.type == SOURCE_NTRIP)
+        {
+            length = source.ntrip.addBytes(tcp_data, count);
+        }
+
+        // A resync can leave whole frames buffered, they are taken out
+        // before the next block is read
+        uint32_t used = 0;
+        do
+        {
+            used += source.framer.addBytes(tcp_data + used, length - used);
+            if (source.framer.frameLength() == 0)
+            {
+                continue;
+            }
+
+            // The latency message stamps the epoch before it and is not
+            // passed on to the receiver
+            uint32_t ingest_time;
+            if (parseLatencyFrame(source.framer.frame(), source.framer.frameLength(), ingest_time))
+            {
+                if (index == selector.active)
+                {
+                    recordLatency(ingest_time);
+                }
+                continue;
+            }
+
+            // Queue RTCM frame for the GNSS receiver correction input
+            sourceFrame(index, source.framer.frame(), source.framer.frameLength());
+        } while (used < length || source.framer.frameLength() != 0);
+    }
+    drainCorrections();
+
+    // Caster refused the request or ended the stream
+    if (source.type == SOURCE_NTRIP && source.ntrip.failed())
+    {
+        Serial.print(millis()/1000.0);Serial.print(" NTRIP stream closed: ");Serial.println(sourceNtripStatus(source));
+        if (source.ntrip.error != NTRIP_OK)
+        {
+            source.connector.retryAfter(source.client, NTRIP_REFUSED_RETRY);
+        }
+        else
+        {
+            source.client.stop();
+        }
     }
-    if (data_read)
+    if (total > 0)
     {
-        Serial.print(millis()/1000.0);Serial.print(" RTCM chars read: ");Serial.println(i);
-        
-        // Send RTCM data to GNSS receiver correction input
-        Serial1.write(rtcm_data, i);
+        Serial.print(millis()/1000.0);Serial.print(" RTCM chars read from ");Serial.print(source.name);Serial.print(": ");Serial.println(total);
     }
 }
 
-// Connect to WiFi
-void connectWiFi() 
+// Read RTCM frames sent by UDP from the base station, track the datagram
+// sequence numbers, rebuild lost frames from the parity datagrams and send
+// the frames to the GNSS receiver in order
+void readAndSendUDPData()
 {
-    int try_count = 0;
-    while ( WiFi.status() != WL_CONNECTED )
+    static uint8_t datagram[UDP_HEADER_LENGTH + UDP_PARITY_LENGTH];
+
+    while (correction_udp.parsePacket() > 0)
     {
-        try_count++;
-        WiFi.disconnect();
-        WiFi.mode(WIFI_STA);
-        WiFi.begin( ssid, password );
-        Serial.print("Connecting to WiFi .");
-        if ( try_count == 10 )
+        int length = correction_udp.read(datagram, sizeof(datagram));
+
+        UDPHeader header;
+        if (!parseUDPHeader(datagram, length, header))
+        {
+            continue;
+        }
+
+        // Both kinds of datagram name the first datagram of their group
+        bool parity = header.flags & UDP_FLAG_PARITY;
+        uint32_t first_sequence = parity ? header.sequence : header.sequence - header.fec_index;
+        if (!parity && !udp_tracker.update(header.sequence))
+        {
+            continue;
+        }
+
+        // Send what is left of the previous group before starting a new
+        // one, late datagrams of earlier groups are dropped by the decoder
+        if (udp_fec.isNewGroup(first_sequence))
+        {
+            udp_fec.finishGroup();
+            sendUDPFrames();
+        }
+
+        if (parity)
         {
-          ESP.restart();
+            udp_fec.addParity(first_sequence, header.fec_count,
+                              datagram + UDP_HEADER_LENGTH, length - UDP_HEADER_LENGTH);
         }
-        Serial.print('.');
-        delay(1000);
-        if(WiFi.status() == WL_CONNECTED)
+        else
         {
-            Serial.print(" IP Address: ");Serial.println(WiFi.localIP());
-            Serial.print("The MAC address for this board is: ");Serial.println(WiFi.macAddress());
+            if (selector.active == PRIMARY_SOURCE)
+            {
+                followBase(correction_udp.remoteIP());
+            }
+            udp_fec.addData(first_sequence, header.fec_index, datagram + UDP_HEADER_LENGTH,
+                            length - UDP_HEADER_LENGTH, header.timestamp, millis());
         }
+        sendUDPFrames();
+    }
+
+    // Stop waiting for a lost frame that was not rebuilt
+    udp_fec.checkTimeout(millis());
+    sendUDPFrames();
+}
+
+// Send frames released by the FEC decoder to the GNSS receiver
+void sendUDPFrames()
+{
+    uint16_t length = 0;
+    uint32_t timestamp = 0;
+    const uint8_t* frame;
+    RTCMFramer& framer = sources[PRIMARY_SOURCE].framer;
+    while ((frame = udp_fec.next(length, timestamp)) != NULL)
+    {
+        uint16_t used = 0;
+        do
+        {
+            used += framer.addBytes(frame + used, length - used);
+            if (framer.frameLength() == 0)
+            {
+                continue;
+            }
+
+            sourceFrame(PRIMARY_SOURCE, framer.frame(), framer.frameLength());
+
+            // Rebuilt frames carry no timestamp
+            if (timestamp != 0 && selector.active == PRIMARY_SOURCE)
+            {
+                recordLatency(timestamp);
+            }
+        } while (used < length || framer.frameLength() != 0);
+    }
+    drainCorrections();
+}
+
+// Pass a checked frame from a source on to the receiver while the source
+// is active. After a switch the new base station's reference position goes
+// first so the receiver never pairs observations with the old base.
+void sourceFrame(uint8_t index, const uint8_t* frame, uint16_t length)
+{
+    uint8_t result = selector.addFrame(index, frame, length, millis());
+    if (result == SOURCE_DROP)
+    {
+        return;
+    }
+
+    CorrectionSource& source = sources[index];
+    if (result == SOURCE_SWITCHED && source.station_length > 0 &&
+        (source.station_length != length || memcmp(source.station_frame, frame, length) != 0))
+    {
+        writeCorrection(source.station_frame, source.station_length);
     }
+    writeCorrection(frame, length);
+}
+
+// Queue a frame for the GNSS receiver correction input
+void writeCorrection(const uint8_t* frame, uint16_t length)
+{
+    last_write_pending = uart_tx.write(frame, length);
+    wifi_supervisor.firstCorrection();
+    last_write_end = uart_tx.writePosition();
+}
+
+// Note the base UART time of the last frame queued, its latency is added
+// to the histogram once it has been written to the receiver
+void recordLatency(uint32_t ingest_time)
+{
+    if (!last_write_pending)
+    {
+        return;
+    }
+    last_write_pending = false;
+
+    // Oldest stamp is dropped if the queue is full
+    if ((uint8_t)(pending_head - pending_tail) == LATENCY_PENDING)
+    {
+        pending_tail++;
+    }
+    pending_latency[pending_head % LATENCY_PENDING] = {last_write_end, ingest_time};
+    pending_head++;
+}
+
+// Write queued corrections to the GNSS receiver without blocking and
+// record the latency of the frames that have been written
+void drainCorrections()
+{
+
+    uart_tx.drain(Serial1);
+
+    while (pending_tail != pending_head)
+    {
+        PendingLatency& pending = pending_latency[pending_tail % LATENCY_PENDING];
+        if ((int32_t)(pending.end - uart_tx.readPosition()) > 0)
+        {
+            break;
+        }
+        if (clock_sync.synced)
+        {
+            correction_latency.add((int32_t)(clock_sync.toBase(latencyClock()) - pending.ingest_time));
+        }
+        pending_tail++;
+    }
+}
+
+// Ask the base station for its clock and read its replies
+void syncClock()
+{
+    uint8_t data[TIME_SYNC_LENGTH];
+    while (time_sync_udp.parsePacket() > 0)
+    {
+        int length = time_sync_udp.read(data, sizeof(data));
+        clock_sync.handleReply(data, length);
+    }
+
+    if (base_address == IPAddress(0, 0, 0, 0) || millis() < next_time_sync)
+    {
+        return;
+    }
+
+    // Latency messages only come on a raw TCP stream from the base station
+    clock_sync.buildRequest(data, !udp_enabled && sources[selector.active].type == SOURCE_BASE);
+    time_sync_udp.beginPacket(base_address, TIME_SYNC_PORT);
+    time_sync_udp.write(data, TIME_SYNC_LENGTH);
+    time_sync_udp.endPacket();
+    next_time_sync = millis() + TIME_SYNC_PERIOD;
 }
 
 // Read and parse data from GNSS receiver
 void readAndParseGNSS()
 {
 
+    // GGA sentence being received, kept whole for NTRIP upload
+    static char gga_line[NTRIP_MAX_GGA + 1];
+    static int gga_length = 0;
+
     // Read latest GNSS data and send to parser
     while(Serial1.available() > 0)
     {
         char ch = Serial1.read();
         gnss.encode(ch);
         //Serial.write(ch);
+
+        if (ch == '$')
+        {
+            gga_length = 0;
+        }
+        if (gga_length < NTRIP_MAX_GGA)
+        {
+            gga_line[gga_length++] = ch;
+            if (ch == '\n' && gga_length > 6 && strncmp(gga_line + 3, "GGA", 3) == 0)
+            {
+                memcpy(last_gga, gga_line, gga_length);
+                last_gga[gga_length] = '\0';
+                gga_length = 0;
+            }
+        }
     }
 
     // If message is updated, then populate fields with GNSS data
@@ -903,6 +1535,14 @@ String init_rtk(const String& var)
     {
       return time_string;
     }
+    if(var == "BOOT_TIMING")
+    {
+      return wifi_supervisor.bootTiming();
+    }
+    if(var == "WIFI_STATUS")
+    {
+      return wifi_supervisor.status();
+    }
     if(var == "UP_TIME")
     {
       return String(millis()/1000.0/60);
@@ -943,6 +1583,58 @@ String init_rtk(const String& var)
     {
       return String(rtk_up);
     }
+    if(var == "BAD_FRAMES")
+    {
+      return String(framesFailed());
+    }
+    if(var == "DROPPED_BYTES")
+    {
+      return String(bytesDiscarded());
+    }
+    if(var == "DROPPED_FRAMES")
+    {
+      return String(uart_tx.frames_dropped);
+    }
+    if(var == "RESYNCS")
+    {
+      return String(resyncs());
+    }
+    if(var == "UDP_LOST")
+    {
+      return String(udp_tracker.lost);
+    }
+    if(var == "UDP_REORDERED")
+    {
+      return String(udp_tracker.reordered);
+    }
+    if(var == "FEC_RECOVERED")
+    {
+      return String(udp_fec.recovered);
+    }
+    if(var == "FEC_FAILED")
+    {
+      return String(udp_fec.unrecoverable);
+    }
+    if(var == "LATENCY")
+    {
+      return correction_latency.summary();
+    }
+    if(var == "BASE_STATUS")
+    {
+      return baseStatus();
+    }
+    if(var == "SOURCE_STATUS")
+    {
+      return selector.status();
+    }
+    if(var == "LINK_STATUS")
+    {
+      return linkStatus();
+    }
+    if(var == "NTRIP_STATUS")
+    {
+      return ntripStatus();
+    }
     return String();
 }
 
@@ -0,0 +1,324 @@
+/** Correction Sources
+ *  Primary and hot-standby correction sources for failover. Every source is
+ *  kept connected and framed on its own and only the frames of the active
+ *  source are passed to the receiver, so a switch always falls between two
+ *  whole frames. Sources are scored by how late their epochs arrive, the age
+ *  of their last frame and the baseline to their base station. The selector
+ *  moves to a better source once it has been better for SOURCE_SWITCH_HOLD,
+ *  and waits for the start of its next epoch so one epoch never mixes two
+ *  sources. When the active source goes quiet the switch is made at the next
+ *  frame of the best remaining source.
+ *  Epoch lateness is the arrival time of the first frame of an epoch less
+ *  the epoch's GNSS time, relative to the earliest arrival seen from any
+ *  source, so sources can be compared without a common clock.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef CORRECTION_SOURCE_H
+#define CORRECTION_SOURCE_H
+
+#include "rtcm_decoder.h"
+
+#define MAX_SOURCES 2
+
+// Source types
+#define SOURCE_BASE 0
+#define SOURCE_NTRIP 1
+#define SOURCE_UDP 2
+
+// A source with no frame for this long is not used (ms)
+#define SOURCE_STALE_TIME 2000
+
+// Frame age counted in the score above this (ms)
+#define SOURCE_AGE_GRACE 1500
+
+// Score cost of each km of baseline (ms)
+#define SOURCE_BASELINE_COST 20.0
+
+// A better source must win by this much for SOURCE_SWITCH_HOLD (ms)
+#define SOURCE_SWITCH_MARGIN 200.0
+#define SOURCE_SWITCH_HOLD 5000
+
+// Largest station reference frame kept for a switch (bytes)
+#define SOURCE_STATION_FRAME 32
+
+// Result of adding a frame to the selector
+#define SOURCE_DROP 0
+#define SOURCE_FORWARD 1
+#define SOURCE_SWITCHED 2
+
+#define NO_SOURCE 0xFF
+
+class CorrectionSource
+{
+  public:
+
+    void begin(uint8_t source_type, const char* source_name)
+    {
+        type = source_type;
+        name = source_name;
+    }
+
+    // Caster request settings for NTRIP sources
+    void setNtrip(const char* caster_host, const char* caster_mountpoint, const char* caster_user,
+                  const char* caster_password, bool caster_v2)
+    {
+        host = caster_host;
+        mountpoint = caster_mountpoint;
+        user = caster_user;
+        password = caster_password;
+        v2 = caster_v2;
+    }
+
+    // Update the statistics with a checked frame received at time (ms),
+    // returns true if the frame starts a new epoch. reference is the
+    // earliest epoch arrival offset seen from any source.
+    bool addFrame(const uint8_t* frame, uint16_t length, unsigned long time, int32_t& reference,
+                  bool& reference_valid)
+    {
+        frames++;
+        last_frame_time = time;
+        uint16_t message_type = decoder.decode(frame, length);
+
+        // Keep the station reference position to send first after a switch
+        if ((message_type == 1005 || message_type == 1006) && length <= SOURCE_STATION_FRAME)
+        {
+            memcpy(station_frame, frame, length);
+            station_length = length;
+            return false;
+        }
+
+        // Only GPS, Galileo and BeiDou MSM carry a time of week in ms
+        uint32_t epoch_time;
+        if (message_type >= 1071 && message_type <= 1077)
+            epoch_time = decoder.epoch_time;
+        else if (message_type >= 1091 && message_type <= 1097)
+            epoch_time = decoder.epoch_time;
+        else if (message_type >= 1121 && message_type <= 1127)
+            epoch_time = decoder.epoch_time + 14000;
+        else
+            return false;
+
+        if (epoch_valid && epoch_time == last_epoch)
+            return false;
+        last_epoch = epoch_time;
+        epoch_valid = true;
+        epochs++;
+
+        // Arrival offset, the reference creeps up by 1 ms an epoch so that
+        // it follows clock drift and is pulled back by the earliest source
+        int32_t offset = (int32_t)(time - epoch_time);
+        if (!reference_valid || (int32_t)(offset - reference) < 0 ||
+            (int32_t)(offset - reference) > 60000)
+        {
+            reference = offset;
+            reference_valid = true;
+        }
+        else
+        {
+            reference++;
+        }
+
+        float late = (int32_t)(offset - reference);
+        lateness = epochs == 1 ? late : lateness + (late - lateness) / 8.0;
+        return true;
+    }
+
+    // True while frames are arriving
+    bool usable(unsigned long now) const
+    {
+        return frames > 0 && now - last_frame_time < SOURCE_STALE_TIME;
+    }
+
+    // Distance from the rover to the base station (km), 0 if unknown
+    double baseline(double rover_latitude, double rover_longitude) const
+    {
+        if (station_length == 0 || (rover_latitude == 0.0 && rover_longitude == 0.0))
+            return 0.0;
+
+        double lat1 = rover_latitude * M_PI / 180.0;
+        double lat2 = decoder.latitude() * M_PI / 180.0;
+        double dlat = lat2 - lat1;
+        double dlon = (decoder.longitude() - rover_longitude) * M_PI / 180.0;
+        double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+        return 2.0 * 6371.0 * atan2(sqrt(a), sqrt(1.0 - a));
+    }
+
+    // Cost of using the source (ms equivalent), lower is better
+    float score(unsigned long now, double rover_latitude, double rover_longitude) const
+    {
+        unsigned long age = now - last_frame_time;
+        float cost = lateness + SOURCE_BASELINE_COST * baseline(rover_latitude, rover_longitude);
+        if (age > SOURCE_AGE_GRACE)
+            cost += age - SOURCE_AGE_GRACE;
+        return cost;
+    }
+
+    // Drop a partial frame when the connection is made again
+    void restart()
+    {
+        framer.reset();
+        epoch_valid = false;
+    }
+
+    // Connection, used by TCP sources
+    WiFiClient client;
+    TCPConnector connector;
+    NtripResponse ntrip;
+    unsigned long next_gga_upload = 0;
+    const char* host = "";
+    const char* mountpoint = "";
+    const char* user = "";
+    const char* password = "";
+    bool v2 = false;
+
+    RTCMFramer framer;
+    RTCMDecoder decoder;
+    uint8_t type = SOURCE_BASE;
+    const char* name = "";
+
+    // Latest station reference frame
+    uint8_t station_frame[SOURCE_STATION_FRAME];
+    uint8_t station_length = 0;
+
+    // Statistics
+    unsigned long frames = 0;
+    unsigned long frames_forwarded = 0;
+    unsigned long epochs = 0;
+    unsigned long last_frame_time = 0;
+    unsigned long active_time = 0;
+    float lateness = 0.0;
+
+  private:
+
+    uint32_t last_epoch = 0;
+    bool epoch_valid = false;
+};
+
+class SourceSelector
+{
+  public:
+
+    void begin(CorrectionSource* source_list, uint8_t count)
+    {
+        sources = source_list;
+        num_sources = count;
+        active = 0;
+        active_since = millis();
+    }
+
+    // Account for a checked frame from a source and decide whether it goes
+    // to the receiver. SOURCE_SWITCHED means the source has just become
+    // active.
+    uint8_t addFrame(uint8_t index, const uint8_t* frame, uint16_t length, unsigned long now)
+    {
+        bool epoch_start = sources[index].addFrame(frame, length, now, reference, reference_valid);
+
+        uint8_t result = SOURCE_FORWARD;
+        if (index == pending && (epoch_start || !sources[active].usable(now)))
+        {
+            switchTo(index, now);
+            result = SOURCE_SWITCHED;
+        }
+
+        if (index != active)
+            return SOURCE_DROP;
+
+        sources[index].frames_forwarded++;
+        last_forward_time = now;
+        return result;
+    }
+
+    // Score the sources and choose the next one, call from loop()
+    void update(double rover_latitude, double rover_longitude, unsigned long now)
+    {
+        uint8_t best = NO_SOURCE;
+        float best_score = 0.0;
+        for (uint8_t i = 0; i < num_sources; i++)
+        {
+            if (!sources[i].usable(now))
+                continue;
+            float score = sources[i].score(now, rover_latitude, rover_longitude);
+            if (best == NO_SOURCE || score < best_score)
+            {
+                best = i;
+                best_score = score;
+            }
+        }
+
+        if (best == NO_SOURCE || best == active)
+        {
+            pending = NO_SOURCE;
+            better_since = 0;
+        }
+        else if (!sources[active].usable(now))
+        {
+            // Fail over at the next frame of the best source
+            pending = best;
+        }
+        else if (best_score + SOURCE_SWITCH_MARGIN < sources[active].score(now, rover_latitude, rover_longitude))
+        {
+            if (better_since == 0)
+                better_since = now;
+            if (now - better_since >= SOURCE_SWITCH_HOLD)
+                pending = best;
+        }
+        else
+        {
+            pending = NO_SOURCE;
+            better_since = 0;
+        }
+    }
+
+    // Time the source has been active (ms), including the current period
+    unsigned long activeTime(uint8_t index) const
+    {
+        return sources[index].active_time + (index == active ? millis() - active_since : 0);
+    }
+
+    // Active source / switches / last gap (s) for the web page
+    String status() const
+    {
+        return String(sources[active].name) + " / " + String(switches) + " / " +
+               String(last_gap / 1000.0, 1);
+    }
+
+    uint8_t active = 0;
+
+    // Statistics, gaps are the time between the last frame passed on from
+    // the old source and the first from the new one (ms)
+    unsigned long switches = 0;
+    unsigned long last_gap = 0;
+    unsigned long max_gap = 0;
+
+  private:
+
+    void switchTo(uint8_t index, unsigned long now)
+    {
+        sources[active].active_time += now - active_since;
+        active = index;
+        active_since = now;
+        pending = NO_SOURCE;
+        better_since = 0;
+
+        switches++;
+        last_gap = now - last_forward_time;
+        if (last_gap > max_gap)
+            max_gap = last_gap;
+
+        Serial.print(now);Serial.print(" Correction source switched to ");Serial.print(sources[index].name);
+        Serial.print(", gap (ms) ");Serial.println(last_gap);
+    }
+
+    CorrectionSource* sources = NULL;
+    uint8_t num_sources = 0;
+    uint8_t pending = NO_SOURCE;
+    unsigned long active_since = 0;
+    unsigned long better_since = 0;
+    unsigned long last_forward_time = 0;
+    int32_t reference = 0;
+    bool reference_valid = false;
+};
+
+#endif
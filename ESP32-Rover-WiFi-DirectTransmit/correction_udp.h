@@ -0,0 +1,400 @@
+/** UDP Correction Transport
+ *  Datagram format used when the base sends each RTCM frame once by UDP
+ *  broadcast or multicast instead of over one TCP stream per rover.
+ *  Each datagram is a 16 byte header followed by one complete RTCM frame:
+ *    0  'T' 'R'   magic
+ *    2  version
+ *    3  flags
+ *    4  sequence number (uint32, little endian)
+ *    8  epoch id (uint16, little endian)
+ *    10 FEC index, position of the datagram in its parity group
+ *    11 FEC count, number of datagrams covered by a parity datagram
+ *    12 timestamp, base clock (us, see latency.h) when the frame was read from
+ *       the UART (uint32, little endian)
+ *  The rover uses the sequence numbers to count lost and reordered datagrams.
+ *
+ *  Optional forward error correction: after every group of up to
+ *  udp_fec_group frames, and at the end of each MSM epoch, the base sends
+ *  a parity datagram (UDP_FLAG_PARITY) holding the XOR of the group's
+ *  frames, each zero padded to the longest, preceded by the XOR of their
+ *  lengths. Its sequence number is that of the first datagram of the group.
+ *  A rover missing exactly one datagram of a group rebuilds it from the
+ *  others and the parity. Frames after a gap are held for at most
+ *  UDP_FEC_HOLD_TIME so that recovered frames are still written in order.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef CORRECTION_UDP_H
+#define CORRECTION_UDP_H
+
+#define UDP_HEADER_LENGTH 16
+#define UDP_VERSION 1
+
+// Header flags
+#define UDP_FLAG_PARITY 0x01
+
+// Max data datagrams covered by one parity datagram
+#define UDP_MAX_FEC_GROUP 8
+
+// Parity payload, XOR of the frame lengths and of the padded frames
+#define UDP_PARITY_LENGTH (2 + RTCM_MAX_FRAME_LENGTH)
+
+// Longest time frames after a lost datagram wait for it to be rebuilt (ms)
+#define UDP_FEC_HOLD_TIME 50
+
+struct UDPHeader
+{
+    uint8_t flags;
+    uint32_t sequence;
+    uint16_t epoch;
+    uint8_t fec_index;
+    uint8_t fec_count;
+    uint32_t timestamp;
+};
+
+// Write a header into the first UDP_HEADER_LENGTH bytes of a datagram
+void packUDPHeader(uint8_t* data, const UDPHeader& header)
+{
+    data[0] = 'T';
+    data[1] = 'R';
+    data[2] = UDP_VERSION;
+    data[3] = header.flags;
+    for (int i = 0; i < 4; i++)
+        data[4 + i] = header.sequence >> (8 * i);
+    data[8] = header.epoch;
+    data[9] = header.epoch >> 8;
+    data[10] = header.fec_index;
+    data[11] = header.fec_count;
+    for (int i = 0; i < 4; i++)
+        data[12 + i] = header.timestamp >> (8 * i);
+}
+
+// Read the header of a received datagram, returns false if it is not a
+// correction datagram
+bool parseUDPHeader(const uint8_t* data, int length, UDPHeader& header)
+{
+    if (length < UDP_HEADER_LENGTH || data[0] != 'T' || data[1] != 'R' || data[2] != UDP_VERSION)
+        return false;
+
+    header.flags = data[3];
+    header.sequence = 0;
+    for (int i = 0; i < 4; i++)
+        header.sequence |= (uint32_t)data[4 + i] << (8 * i);
+    header.epoch = data[8] | (data[9] << 8);
+    header.fec_index = data[10];
+    header.fec_count = data[11];
+    header.timestamp = 0;
+    for (int i = 0; i < 4; i++)
+        header.timestamp |= (uint32_t)data[12 + i] << (8 * i);
+    return true;
+}
+
+// Counts lost and reordered datagrams from their sequence numbers
+class UDPSequenceTracker
+{
+  public:
+
+    // Returns false for duplicates of datagrams already received
+    bool update(uint32_t sequence)
+    {
+        received++;
+
+        if (!started)
+        {
+            started = true;
+            next = sequence + 1;
+            return true;
+        }
+
+        int32_t gap = (int32_t)(sequence - next);
+        if (gap == 0)
+        {
+            next++;
+        }
+        else if (gap > 0)
+        {
+            // Datagrams in between are missing, they may still arrive late
+            lost += gap;
+            next = sequence + 1;
+        }
+        else if (gap > -64 && lost > 0)
+        {
+            // Late arrival of a datagram counted as lost
+            reordered++;
+            lost--;
+        }
+        else
+        {
+            duplicates++;
+            return false;
+        }
+        return true;
+    }
+
+    unsigned long received = 0;
+    unsigned long lost = 0;
+    unsigned long reordered = 0;
+    unsigned long duplicates = 0;
+
+  private:
+
+    bool started = false;
+    uint32_t next = 0;
+};
+
+// XOR a frame into a parity buffer, four bytes at a time where possible
+void xorFrame(uint8_t* parity, const uint8_t* frame, uint16_t length)
+{
+    uint16_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        uint32_t a, b;
+        memcpy(&a, parity + i, 4);
+        memcpy(&b, frame + i, 4);
+        a ^= b;
+        memcpy(parity + i, &a, 4);
+    }
+    for (; i < length; i++)
+        parity[i] ^= frame[i];
+}
+
+// Builds the parity datagram payload for a group of frames on the base
+class UDPParityEncoder
+{
+  public:
+
+    // Add a frame sent with sequence number sequence
+    void add(uint32_t sequence, const uint8_t* frame, uint16_t length)
+    {
+        if (count == 0)
+        {
+            memset(parity, 0, 2 + max_length);
+            max_length = 0;
+            first_sequence = sequence;
+        }
+
+        xorFrame(parity + 2, frame, length);
+        length_xor ^= length;
+        if (length > max_length)
+            max_length = length;
+        count++;
+    }
+
+    // Parity payload of the frames added since the last reset()
+    const uint8_t* data()
+    {
+        parity[0] = length_xor;
+        parity[1] = length_xor >> 8;
+        return parity;
+    }
+    uint16_t length() const { return 2 + max_length; }
+
+    // Start a new group
+    void reset()
+    {
+        count = 0;
+        length_xor = 0;
+    }
+
+    uint8_t count = 0;
+    uint32_t first_sequence = 0;
+
+  private:
+
+    uint8_t parity[UDP_PARITY_LENGTH] = {0};
+    uint16_t length_xor = 0;
+    uint16_t max_length = 0;
+};
+
+// Holds the frames of the current parity group on the rover, rebuilds a
+// single missing frame from the parity datagram and hands the frames out
+// in sequence order
+class UDPParityDecoder
+{
+  public:
+
+    // True if a datagram of the group starting at first_sequence would
+    // replace the current group, which should be finished and drained first.
+    // Only later groups replace it, sequence numbers wrap around.
+    bool isNewGroup(uint32_t first_sequence) const
+    {
+        return !started || (int32_t)(first_sequence - group_first) > 0;
+    }
+
+    // True for a late datagram of a group before the current one, its frame
+    // can no longer be written in order and is dropped
+    bool isOldGroup(uint32_t first_sequence) const
+    {
+        return started && (int32_t)(first_sequence - group_first) < 0;
+    }
+
+    // Give up on missing frames of the current group, the frames still held
+    // are handed out by next()
+    void finishGroup()
+    {
+        finishing = true;
+    }
+
+    // Add the frame of a data datagram and its header timestamp
+    void addData(uint32_t first_sequence, uint8_t index, const uint8_t* frame,
+                 uint16_t length, uint32_t timestamp, unsigned long time_ms)
+    {
+        if (index >= UDP_MAX_FEC_GROUP || length > RTCM_MAX_FRAME_LENGTH)
+            return;
+        if (isOldGroup(first_sequence))
+        {
+            late++;
+            return;
+        }
+        if (isNewGroup(first_sequence))
+            startGroup(first_sequence);
+
+        // Already handed out or skipped
+        if (index < next_out || (received & (1 << index)))
+        {
+            late++;
+            return;
+        }
+
+        memcpy(frames[index], frame, length);
+        frame_length[index] = length;
+        frame_time[index] = timestamp;
+        received |= 1 << index;
+
+        // Arrived after a gap, hold it until the gap is filled
+        if (index > next_out && hold_since == 0)
+            hold_since = time_ms;
+    }
+
+    // Add a parity datagram and rebuild the missing frame if only one is
+    // missing. The group is complete afterwards.
+    void addParity(uint32_t first_sequence, uint8_t count, const uint8_t* data, uint16_t length)
+    {
+        if (count == 0 || count > UDP_MAX_FEC_GROUP || length < 2 || length > UDP_PARITY_LENGTH)
+            return;
+        if (isOldGroup(first_sequence))
+        {
+            late++;
+            return;
+        }
+        if (isNewGroup(first_sequence))
+            startGroup(first_sequence);
+
+        int missing = -1;
+        int num_missing = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (!(received & (1 << i)))
+            {
+                missing = i;
+                num_missing++;
+            }
+        }
+
+        if (num_missing == 1 && missing >= next_out)
+        {
+            uint16_t rebuilt_length = data[0] | (data[1] << 8);
+            for (int i = 0; i < count; i++)
+            {
+                if (i != missing)
+                    rebuilt_length ^= frame_length[i];
+            }
+
+            if (rebuilt_length <= length - 2)
+            {
+                memcpy(frames[missing], data + 2, rebuilt_length);
+                for (int i = 0; i < count; i++)
+                {
+                    if (i == missing)
+                        continue;
+                    uint16_t n = frame_length[i] < rebuilt_length ? frame_length[i] : rebuilt_length;
+                    xorFrame(frames[missing], frames[i], n);
+                }
+                frame_length[missing] = rebuilt_length;
+                frame_time[missing] = 0;
+                received |= 1 << missing;
+                recovered++;
+            }
+            else
+            {
+                unrecoverable++;
+            }
+        }
+        else if (num_missing > 0)
+        {
+            // Several frames missing, or the gap was already skipped
+            unrecoverable++;
+        }
+
+        group_count = count;
+        finishing = true;
+    }
+
+    // Give up waiting for a lost frame once later frames have been held
+    // for UDP_FEC_HOLD_TIME
+    void checkTimeout(unsigned long time_ms)
+    {
+        if (hold_since != 0 && time_ms - hold_since > UDP_FEC_HOLD_TIME)
+            finishing = true;
+    }
+
+    // Next frame to be written in sequence order and its timestamp (0 for
+    // rebuilt frames), NULL if none is ready
+    const uint8_t* next(uint16_t& length, uint32_t& timestamp)
+    {
+        while (next_out < group_count)
+        {
+            uint8_t index = next_out;
+            if (received & (1 << index))
+            {
+                next_out++;
+                length = frame_length[index];
+                timestamp = frame_time[index];
+                return frames[index];
+            }
+
+            // Later frames wait for this one unless the group is finished
+            if (!finishing || (received >> index) == 0)
+            {
+                if ((received >> index) == 0)
+                    hold_since = 0;
+                return NULL;
+            }
+            next_out++;
+        }
+        hold_since = 0;
+        return NULL;
+    }
+
+    // Statistics
+    unsigned long recovered = 0;
+    unsigned long unrecoverable = 0;
+    unsigned long late = 0;
+
+  private:
+
+    void startGroup(uint32_t first_sequence)
+    {
+        started = true;
+        group_first = first_sequence;
+        group_count = UDP_MAX_FEC_GROUP;
+        received = 0;
+        next_out = 0;
+        finishing = false;
+        hold_since = 0;
+    }
+
+    uint8_t frames[UDP_MAX_FEC_GROUP][RTCM_MAX_FRAME_LENGTH];
+    uint16_t frame_length[UDP_MAX_FEC_GROUP] = {0};
+    uint32_t frame_time[UDP_MAX_FEC_GROUP] = {0};
+    uint16_t received = 0;
+    uint8_t next_out = 0;
+    uint8_t group_count = UDP_MAX_FEC_GROUP;
+    uint32_t group_first = 0;
+    bool started = false;
+    bool finishing = false;
+    unsigned long hold_since = 0;
+};
+
+#endif
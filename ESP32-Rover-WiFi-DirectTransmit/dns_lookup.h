@@ -0,0 +1,110 @@
+/** DNS Lookup
+ *  Non-blocking host name lookup for the connection state machines.
+ *  WiFi.hostByName() waits for the DNS answer, which stalls loop() for the
+ *  whole DNS timeout when the server is slow or unreachable. Here the
+ *  lookup is handed to the lwIP thread and the answer is polled from
+ *  loop(). Names in dotted address form are converted straight away.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef DNS_LOOKUP_H
+#define DNS_LOOKUP_H
+
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+
+// Time allowed for an answer, lwIP gives up on its own before this (ms)
+#define LOOKUP_TIMEOUT 15000
+
+// Lookup states
+#define LOOKUP_IDLE 0
+#define LOOKUP_PENDING 1
+#define LOOKUP_DONE 2
+#define LOOKUP_FAILED 3
+
+class DNSLookup
+{
+  public:
+
+    // Start looking up a name, the answer is read with poll()
+    void start(const char* name)
+    {
+        IPAddress parsed;
+        if (parsed.fromString(name))
+        {
+            answer = (uint32_t)parsed;
+            state = LOOKUP_DONE;
+            return;
+        }
+
+        host = name;
+        start_time = millis();
+        state = LOOKUP_PENDING;
+        call.lookup = this;
+        tcpip_api_call(startCall, &call.base);
+    }
+
+    // LOOKUP_PENDING until the answer has arrived, then LOOKUP_DONE with
+    // the address in address() or LOOKUP_FAILED
+    uint8_t poll()
+    {
+        if (state == LOOKUP_PENDING && millis() - start_time > LOOKUP_TIMEOUT)
+            state = LOOKUP_FAILED;
+        return state;
+    }
+
+    IPAddress address() const { return IPAddress(answer); }
+
+  private:
+
+    // Arguments of the call run in the lwIP thread
+    struct Call
+    {
+        struct tcpip_api_call_data base;
+        DNSLookup* lookup;
+    };
+
+    // Runs in the lwIP thread, where DNS calls are allowed
+    static err_t startCall(struct tcpip_api_call_data* data)
+    {
+        DNSLookup* lookup = ((Call*)data)->lookup;
+        ip_addr_t result;
+        err_t error = dns_gethostbyname(lookup->host, &result, found, lookup);
+        if (error == ERR_OK)
+            lookup->finish(&result);
+        else if (error != ERR_INPROGRESS)
+            lookup->finish(NULL);
+        return ERR_OK;
+    }
+
+    // Answer or failure from the lwIP DNS client. A late answer to an
+    // earlier lookup is for the same name and is still used.
+    static void found(const char* name, const ip_addr_t* result, void* arg)
+    {
+        ((DNSLookup*)arg)->finish(result);
+    }
+
+    void finish(const ip_addr_t* result)
+    {
+        if (result != NULL && IP_IS_V4(result))
+        {
+            answer = ip_2_ip4(result)->addr;
+            state = LOOKUP_DONE;
+        }
+        else
+        {
+            state = LOOKUP_FAILED;
+        }
+    }
+
+    Call call;
+    const char* host = "";
+    unsigned long start_time = 0;
+
+    // Written by the lwIP thread
+    volatile uint32_t answer = 0;
+    volatile uint8_t state = LOOKUP_IDLE;
+};
+
+#endif
@@ -2,7 +2,63 @@
 const char* ssid = "XXXXXXX";
 const char* password = "XXXXXXX";
 
+// Longest WiFi outage before the ESP32 restarts (s), 0 never restarts. The
+// correction pipeline keeps running and reconnects in the background until
+// then.
+const unsigned long wifi_restart_grace = 300;
+
+// Connect straight to the last access point (BSSID and channel saved in
+// flash) instead of scanning first. wifi_reuse_lease also reuses the last
+// DHCP address without asking the server again, only use it when the router
+// keeps the address reserved for this board.
+const bool wifi_fast_connect = true;
+const bool wifi_reuse_lease = false;
+
+// Optional static address, skips DHCP on boot and after every dropout
+const bool wifi_static_ip = false;
+IPAddress wifi_ip(192, 168, 86, 36);
+IPAddress wifi_gateway(192, 168, 86, 1);
+IPAddress wifi_subnet(255, 255, 255, 0);
+IPAddress wifi_dns(192, 168, 86, 1);
+
 // IP address of the base station ESP32
 // This is printed to USB when the base station runs
 // attached to a serial port
 IPAddress serverAddress(192, 168, 86, 35);
+
+// Find the base station from its UDP beacon instead of serverAddress, which
+// is then only used until the first beacon is heard. Only beacons from the
+// base station whose base_hostname is base_name are followed.
+const bool base_discovery = true;
+const char* base_name = "tinkerrtk-base";
+
+// Receive corrections by UDP from the base station instead of over TCP, the
+// address must match udp_address on the base station (multicast group or
+// 255.255.255.255 for broadcast)
+const bool udp_enabled = false;
+IPAddress udp_address(239, 0, 0, 81);
+
+// Receive corrections from an NTRIP caster instead of the base station's raw
+// TCP port. ntrip_host can be the base station (port 2101) or any caster.
+// The rover position is uploaded as a GGA sentence every ntrip_gga_period ms
+// for VRS mountpoints, 0 disables the upload.
+const bool ntrip_enabled = false;
+const char* ntrip_host = "192.168.86.35";
+const uint16_t ntrip_port = 2101;
+const char* ntrip_mountpoint = "TINKER";
+const char* ntrip_user = "";
+const char* ntrip_password = "";
+const bool ntrip_v2 = true;
+const unsigned long ntrip_gga_period = 10000;
+
+// Hot-standby correction source, kept connected alongside the one above and
+// used when it is better or the active source stops. An empty
+// standby_mountpoint connects to a base station's raw TCP port, otherwise
+// standby_host is an NTRIP caster. The standby is always a TCP source.
+const bool standby_enabled = false;
+const char* standby_host = "192.168.86.37";
+const uint16_t standby_port = 4081;
+const char* standby_mountpoint = "";
+const char* standby_user = "";
+const char* standby_password = "";
+const bool standby_v2 = true;
@@ -0,0 +1,266 @@
+/** Correction Latency
+ *  End to end latency measurement from the base UART to the rover UART.
+ *  The base stamps each frame with its own microsecond clock when the last
+ *  byte of the frame is read from the UART. Over UDP the stamp is the
+ *  datagram header timestamp. Over TCP the last frame of each MSM epoch is
+ *  followed by a small message in the proprietary RTCM range that the rover
+ *  removes before its receiver sees it. The message number is not ours, so
+ *  the base only adds it for raw TCP rovers that ask for it with
+ *  TIME_SYNC_MARKERS in their clock requests, and never to NTRIP clients,
+ *  the caster upload or the flash log. The rover keeps its clock offset to
+ *  the base with a request / reply exchange on TIME_SYNC_PORT, using the
+ *  reply with the shortest round trip, and adds the age of each stamped
+ *  frame at the moment it is written to its UART to a histogram.
+ *  Latency message payload:
+ *    12 bits message number LATENCY_MESSAGE_TYPE
+ *    4 bits  version
+ *    32 bits base clock (us) when the previous frame was read from the UART
+ *  Clock request flags (byte 3):
+ *    TIME_SYNC_MARKERS  follow each epoch on this rover's TCP stream with
+ *                       the latency message
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <esp_timer.h>
+
+// Proprietary message number carrying the timestamp of the previous frame
+#define LATENCY_MESSAGE_TYPE 4088
+#define LATENCY_VERSION 1
+#define LATENCY_FRAME_LENGTH 12
+
+// Clock synchronisation request / reply port on the base
+#define TIME_SYNC_PORT 4083
+#define TIME_SYNC_LENGTH 12
+#define TIME_SYNC_MARKERS 0x01
+
+// Histogram bins: 1 ms up to 100 ms, then 10 ms up to 1 s, then one open bin
+#define LATENCY_FINE_BINS 100
+#define LATENCY_COARSE_BINS 90
+#define LATENCY_BINS (LATENCY_FINE_BINS + LATENCY_COARSE_BINS + 1)
+
+// Microsecond clock shared by the timestamps, wraps after 71 minutes
+uint32_t latencyClock()
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+// Build the latency message for a frame read from the UART at ingest_time,
+// returns the frame length
+int buildLatencyFrame(uint8_t* frame, uint32_t ingest_time)
+{
+    frame[0] = 0xD3;
+    frame[1] = 0;
+    frame[2] = 6;
+    frame[3] = LATENCY_MESSAGE_TYPE >> 4;
+    frame[4] = ((LATENCY_MESSAGE_TYPE & 0x0F) << 4) | LATENCY_VERSION;
+    for (int i = 0; i < 4; i++)
+        frame[5 + i] = ingest_time >> (24 - 8 * i);
+
+    uint32_t crc = crc24q(frame, 9);
+    frame[9] = crc >> 16;
+    frame[10] = crc >> 8;
+    frame[11] = crc;
+    return LATENCY_FRAME_LENGTH;
+}
+
+// Read the timestamp from a validated frame, returns false if the frame is
+// not a latency message
+bool parseLatencyFrame(const uint8_t* frame, uint16_t length, uint32_t& ingest_time)
+{
+    if (length != LATENCY_FRAME_LENGTH ||
+        ((frame[3] << 4) | (frame[4] >> 4)) != LATENCY_MESSAGE_TYPE ||
+        (frame[4] & 0x0F) != LATENCY_VERSION)
+        return false;
+
+    ingest_time = ((uint32_t)frame[5] << 24) | ((uint32_t)frame[6] << 16) |
+                  ((uint32_t)frame[7] << 8) | frame[8];
+    return true;
+}
+
+void packTime(uint8_t* data, uint32_t time)
+{
+    for (int i = 0; i < 4; i++)
+        data[i] = time >> (8 * i);
+}
+
+uint32_t unpackTime(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Base: answer a clock request 'T' 'S' 0 flags t0 with 'T' 'S' 1 flags t0 t1,
+// where t1 is the base clock. Returns false if the request is not valid.
+bool buildTimeSyncReply(uint8_t* data, int length)
+{
+    if (length < TIME_SYNC_LENGTH || data[0] != 'T' || data[1] != 'S' || data[2] != 0)
+        return false;
+    data[2] = 1;
+    packTime(data + 8, latencyClock());
+    return true;
+}
+
+// Distribution of correction ages, percentiles are read from the bins
+class LatencyHistogram
+{
+  public:
+
+    // Add a latency (us), negative values mean the clocks are out of sync
+    void add(int32_t latency)
+    {
+        if (latency < 0)
+        {
+            negative++;
+            return;
+        }
+
+        uint32_t ms = latency / 1000;
+        int bin;
+        if (ms < LATENCY_FINE_BINS)
+            bin = ms;
+        else if (ms < LATENCY_FINE_BINS + 10 * LATENCY_COARSE_BINS)
+            bin = LATENCY_FINE_BINS + (ms - LATENCY_FINE_BINS) / 10;
+        else
+            bin = LATENCY_BINS - 1;
+
+        bins[bin]++;
+        count++;
+        total += latency;
+        if ((uint32_t)latency > max_latency)
+            max_latency = latency;
+    }
+
+    // Latency (ms) below which a fraction p of the samples fall, taken as
+    // the upper edge of the bin holding the percentile
+    float percentile(float p) const
+    {
+        if (count == 0)
+            return 0.0;
+
+        unsigned long target = p * count;
+        unsigned long seen = 0;
+        for (int bin = 0; bin < LATENCY_BINS; bin++)
+        {
+            seen += bins[bin];
+            if (seen > target)
+            {
+                if (bin < LATENCY_FINE_BINS)
+                    return bin + 1;
+                if (bin < LATENCY_BINS - 1)
+                    return LATENCY_FINE_BINS + 10 * (bin - LATENCY_FINE_BINS + 1);
+                break;
+            }
+        }
+        return max_latency / 1000.0;
+    }
+
+    float mean() const
+    {
+        return count > 0 ? total / count / 1000.0 : 0.0;
+    }
+
+    void reset()
+    {
+        memset(bins, 0, sizeof(bins));
+        count = 0;
+        negative = 0;
+        total = 0;
+        max_latency = 0;
+    }
+
+    // Summary as JSON, times in ms. Extra members, each starting with a
+    // comma, are added to the object before it is closed.
+    int toJSON(char* buffer, int size, const char* extra = "") const
+    {
+        int n = snprintf(buffer, size,
+                         "{\"count\":%lu,\"negative\":%lu,\"mean\":%.1f,\"p50\":%.0f,\"p95\":%.0f,"
+                         "\"p99\":%.0f,\"max\":%.1f%s}",
+                         count, negative, mean(), percentile(0.50), percentile(0.95),
+                         percentile(0.99), max_latency / 1000.0, extra);
+        return n < size ? n : size - 1;
+    }
+
+    // p50 / p95 / p99 for the web page
+    String summary() const
+    {
+        if (count == 0)
+            return "None";
+        return String(percentile(0.50), 0) + " / " + String(percentile(0.95), 0) + " / " +
+               String(percentile(0.99), 0);
+    }
+
+    unsigned long count = 0;
+    unsigned long negative = 0;
+
+  private:
+
+    unsigned long bins[LATENCY_BINS] = {0};
+    double total = 0;
+    uint32_t max_latency = 0;
+};
+
+// Rover: estimate of the base clock from request / reply exchanges
+class ClockSync
+{
+  public:
+
+    // Fill in a request stamped with the rover clock, markers asks the base
+    // for latency messages on the TCP stream
+    void buildRequest(uint8_t* data, bool markers)
+    {
+        memset(data, 0, TIME_SYNC_LENGTH);
+        data[0] = 'T';
+        data[1] = 'S';
+        data[3] = markers ? TIME_SYNC_MARKERS : 0;
+        packTime(data + 4, latencyClock());
+    }
+
+    // Use a reply to update the offset, returns false if it is not a reply
+    bool handleReply(const uint8_t* data, int length)
+    {
+        if (length < TIME_SYNC_LENGTH || data[0] != 'T' || data[1] != 'S' || data[2] != 1)
+            return false;
+
+        uint32_t now = latencyClock();
+        uint32_t sent = unpackTime(data + 4);
+        uint32_t base_time = unpackTime(data + 8);
+        uint32_t round_trip = now - sent;
+
+        // Older estimates lose weight so that clock drift is followed
+        if (!synced || round_trip <= best_round_trip + drift_allowance)
+        {
+            offset = (int32_t)(base_time + round_trip / 2 - now);
+            best_round_trip = round_trip;
+            drift_allowance = 0;
+            synced = true;
+        }
+        else
+        {
+            drift_allowance += 500;
+        }
+        last_round_trip = round_trip;
+        replies++;
+        return true;
+    }
+
+    // Convert a rover clock time to the base clock
+    uint32_t toBase(uint32_t rover_time) const
+    {
+        return rover_time + offset;
+    }
+
+    bool synced = false;
+    int32_t offset = 0;
+    uint32_t best_round_trip = 0;
+    uint32_t last_round_trip = 0;
+    unsigned long replies = 0;
+
+  private:
+
+    uint32_t drift_allowance = 0;
+};
+
+#endif
@@ -0,0 +1,282 @@
+/** NTRIP Client
+ *  Request building and response decoding for the rover's NTRIP client mode.
+ *  The response is decoded one byte at a time as it is read from the socket:
+ *  status line and headers are checked, chunked transfer encoding (NTRIP v2)
+ *  is stripped and every correction byte is handed straight on to the RTCM
+ *  framer, so no copy of the stream is kept here. Blocks read from the
+ *  socket are decoded in place, correction data in them is only scanned
+ *  byte by byte while headers or chunk framing are being read.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef NTRIP_CLIENT_H
+#define NTRIP_CLIENT_H
+
+// Longest response status or header line that is checked (bytes)
+#define NTRIP_MAX_LINE 96
+
+// Longest NMEA GGA sentence kept for upload (bytes)
+#define NTRIP_MAX_GGA 100
+
+// Decoder states
+#define NTRIP_STATUS 0
+#define NTRIP_HEADERS 1
+#define NTRIP_DATA 2
+#define NTRIP_CHUNK_SIZE 3
+#define NTRIP_CHUNK_EXTENSION 4
+#define NTRIP_CHUNK_DATA 5
+#define NTRIP_CHUNK_END 6
+#define NTRIP_DONE 7
+#define NTRIP_ERROR 8
+
+// Response errors
+#define NTRIP_OK 0
+#define NTRIP_UNAUTHORIZED 1
+#define NTRIP_NOT_FOUND 2
+#define NTRIP_BAD_RESPONSE 3
+
+const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Base64 encoding of a string, used for Basic authorization
+String base64Encode(const String& text)
+{
+    String encoded = "";
+    for (unsigned int i = 0; i < text.length(); i += 3)
+    {
+        int count = text.length() - i < 3 ? text.length() - i : 3;
+
+        // Pack up to three bytes into 24 bits, missing bytes are zero
+        uint32_t group = (uint8_t)text[i] << 16;
+        if (count > 1)
+            group |= (uint8_t)text[i + 1] << 8;
+        if (count > 2)
+            group |= (uint8_t)text[i + 2];
+
+        for (int j = 0; j < 4; j++)
+        {
+            if (j <= count)
+                encoded += base64_chars[(group >> (18 - 6 * j)) & 0x3F];
+            else
+                encoded += '=';
+        }
+    }
+    return encoded;
+}
+
+// GET request for a mountpoint, gga is sent in the header to v2 casters
+String ntripRequest(const char* host, const char* mountpoint, const char* user,
+                    const char* password, bool v2, const char* gga)
+{
+    String request = "GET /" + String(mountpoint) + " HTTP/1.1\r\n";
+    request += "Host: " + String(host) + "\r\n";
+    request += "User-Agent: NTRIP TinkerRTK/1.0\r\n";
+    if (v2)
+    {
+        request += "Ntrip-Version: Ntrip/2.0\r\n";
+        if (gga[0] != '\0')
+        {
+            // Sentence without its line ending
+            String line = gga;
+            line.trim();
+            request += "Ntrip-GGA: " + line + "\r\n";
+        }
+    }
+    if (user[0] != '\0')
+    {
+        request += "Authorization: Basic " + base64Encode(String(user) + ":" + password) + "\r\n";
+    }
+    request += "Connection: close\r\n\r\n";
+    return request;
+}
+
+class NtripResponse
+{
+  public:
+
+    // Start decoding a new response
+    void reset()
+    {
+        state = NTRIP_STATUS;
+        error = NTRIP_OK;
+        line_length = 0;
+        chunked = false;
+        chunk_remaining = 0;
+        version = 1;
+    }
+
+    // Decode one received byte, returns true if it is correction data
+    bool addByte(uint8_t ch)
+    {
+        switch (state)
+        {
+            case NTRIP_DATA:
+                return true;
+
+            case NTRIP_CHUNK_DATA:
+                if (--chunk_remaining == 0)
+                    state = NTRIP_CHUNK_END;
+                return true;
+
+            case NTRIP_STATUS:
+            case NTRIP_HEADERS:
+                // v1 casters may start the data right after the status line
+                if (state == NTRIP_HEADERS && line_length == 0 && ch == 0xD3 && version == 1)
+                {
+                    state = NTRIP_DATA;
+                    return true;
+                }
+                if (ch == '\n')
+                {
+                    line[line_length] = '\0';
+                    if (line_length > 0 && line[line_length - 1] == '\r')
+                        line[--line_length] = '\0';
+                    endOfLine();
+                    line_length = 0;
+                }
+                else if (line_length < NTRIP_MAX_LINE)
+                {
+                    line[line_length++] = ch;
+                }
+                return false;
+
+            case NTRIP_CHUNK_SIZE:
+                if (isxdigit(ch))
+                {
+                    chunk_remaining = (chunk_remaining << 4) |
+                                      (isdigit(ch) ? ch - '0' : (tolower(ch) - 'a' + 10));
+                }
+                else if (ch == '\n')
+                {
+                    startChunk();
+                }
+                else
+                {
+                    // Chunk extension or the CR before the LF
+                    state = NTRIP_CHUNK_EXTENSION;
+                }
+                return false;
+
+            case NTRIP_CHUNK_EXTENSION:
+                if (ch == '\n')
+                    startChunk();
+                return false;
+
+            case NTRIP_CHUNK_END:
+                // CR LF after the chunk data
+                if (ch == '\n')
+                {
+                    state = NTRIP_CHUNK_SIZE;
+                    chunk_remaining = 0;
+                }
+                return false;
+
+            default:
+                return false;
+        }
+    }
+
+    // Decode a block of received bytes in place, the correction data is
+    // moved to the start of the block. Returns the number of data bytes.
+    uint32_t addBytes(uint8_t* data, uint32_t length)
+    {
+        uint32_t kept = 0;
+        uint32_t i = 0;
+        while (i < length)
+        {
+            // Spans of correction data are moved as a whole
+            uint32_t span = 0;
+            if (state == NTRIP_DATA)
+            {
+                span = length - i;
+            }
+            else if (state == NTRIP_CHUNK_DATA)
+            {
+                span = chunk_remaining < length - i ? chunk_remaining : length - i;
+                chunk_remaining -= span;
+                if (chunk_remaining == 0)
+                    state = NTRIP_CHUNK_END;
+            }
+
+            if (span > 0)
+            {
+                if (kept != i)
+                    memmove(data + kept, data + i, span);
+                kept += span;
+                i += span;
+                continue;
+            }
+
+            if (addByte(data[i]))
+                data[kept++] = data[i];
+            i++;
+        }
+        return kept;
+    }
+
+    // Response accepted and corrections flowing
+    bool streaming() const { return state >= NTRIP_DATA && state <= NTRIP_CHUNK_END; }
+
+    // Caster refused the request or closed the stream
+    bool failed() const { return state == NTRIP_ERROR || state == NTRIP_DONE; }
+
+    uint8_t state = NTRIP_STATUS;
+    uint8_t error = NTRIP_OK;
+    uint8_t version = 1;
+    bool chunked = false;
+
+  private:
+
+    // Check a complete status or header line
+    void endOfLine()
+    {
+        if (state == NTRIP_STATUS)
+        {
+            if (strncmp(line, "ICY 200", 7) == 0)
+            {
+                version = 1;
+                state = NTRIP_HEADERS;
+            }
+            else if (strncmp(line, "HTTP/1.", 7) == 0 && strncmp(line + 8, " 200", 4) == 0)
+            {
+                version = 2;
+                state = NTRIP_HEADERS;
+            }
+            else
+            {
+                // Sourcetable means the mountpoint is not on the caster
+                if (strncmp(line, "SOURCETABLE", 11) == 0 || strstr(line, " 404") != NULL)
+                    error = NTRIP_NOT_FOUND;
+                else if (strstr(line, " 401") != NULL)
+                    error = NTRIP_UNAUTHORIZED;
+                else
+                    error = NTRIP_BAD_RESPONSE;
+                state = NTRIP_ERROR;
+            }
+            return;
+        }
+
+        // Blank line ends the headers
+        if (line_length == 0)
+        {
+            state = chunked ? NTRIP_CHUNK_SIZE : NTRIP_DATA;
+            chunk_remaining = 0;
+            return;
+        }
+
+        if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line + 18, "chunked") != NULL)
+            chunked = true;
+    }
+
+    // Chunk size line complete, a zero size chunk ends the stream
+    void startChunk()
+    {
+        state = chunk_remaining > 0 ? NTRIP_CHUNK_DATA : NTRIP_DONE;
+    }
+
+    char line[NTRIP_MAX_LINE + 1];
+    uint16_t line_length = 0;
+    uint32_t chunk_remaining = 0;
+};
+
+#endif
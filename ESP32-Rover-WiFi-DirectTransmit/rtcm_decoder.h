@@ -0,0 +1,136 @@
+/** RTCM3 Decoder
+ *  Incremental decoder run once on each frame as it passes through the base.
+ *  Only the station reference messages (1005/1006) are fully decoded, MSM
+ *  observation messages are reduced to the few header fields needed to follow
+ *  epochs and every other message is identified by its number only.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef RTCM_DECODER_H
+#define RTCM_DECODER_H
+
+// Read an unsigned bit field of up to 64 bits, pos counts from the first payload bit
+uint64_t rtcmBits(const uint8_t* payload, uint16_t pos, uint8_t length)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < length; i++, pos++)
+    {
+        value = (value << 1) | ((payload[pos >> 3] >> (7 - (pos & 7))) & 1);
+    }
+    return value;
+}
+
+// Read a two's complement bit field of up to 64 bits
+int64_t rtcmSignedBits(const uint8_t* payload, uint16_t pos, uint8_t length)
+{
+    uint64_t value = rtcmBits(payload, pos, length);
+    if (value & ((uint64_t)1 << (length - 1)))
+        value |= ~(uint64_t)0 << length;
+    return (int64_t)value;
+}
+
+// Multiple Signal Messages, 1071-1077 GPS through 1131-1137 NavIC
+bool rtcmIsMSM(uint16_t message_type)
+{
+    return message_type >= 1071 && message_type <= 1137 &&
+           message_type % 10 >= 1 && message_type % 10 <= 7;
+}
+
+class RTCMDecoder
+{
+  public:
+
+    // Decode the parts of a complete frame (header through CRC) that the
+    // base station uses, returns the message number
+    uint16_t decode(const uint8_t* frame, uint16_t frame_length)
+    {
+        const uint8_t* payload = frame + 3;
+        uint16_t payload_length = frame_length - 6;
+        if (payload_length < 2)
+            return 0;
+
+        uint16_t message_type = rtcmBits(payload, 0, 12);
+
+        if ((message_type == 1005 && payload_length >= 19) ||
+            (message_type == 1006 && payload_length >= 21))
+        {
+            station_id = rtcmBits(payload, 12, 12);
+            ecef[0] = rtcmSignedBits(payload, 34, 38) * 0.0001;
+            ecef[1] = rtcmSignedBits(payload, 74, 38) * 0.0001;
+            ecef[2] = rtcmSignedBits(payload, 114, 38) * 0.0001;
+            if (message_type == 1006)
+                antenna_height = rtcmBits(payload, 152, 16) * 0.0001;
+            station_updated = true;
+            station_messages++;
+        }
+        else if (rtcmIsMSM(message_type) && payload_length >= 7)
+        {
+            // Header only, the satellite and signal data is not needed here
+            station_id = rtcmBits(payload, 12, 12);
+            epoch_time = rtcmBits(payload, 24, 30);
+            multiple_message = rtcmBits(payload, 54, 1);
+            msm_headers++;
+        }
+
+        return message_type;
+    }
+
+    // Geodetic latitude (deg) of the last station reference position
+    double latitude() const
+    {
+        double lat, lon;
+        ecefToGeodetic(lat, lon);
+        return lat;
+    }
+
+    // Geodetic longitude (deg) of the last station reference position
+    double longitude() const
+    {
+        double lat, lon;
+        ecefToGeodetic(lat, lon);
+        return lon;
+    }
+
+    // Station reference position (m), set by 1005/1006
+    double ecef[3] = {0.0, 0.0, 0.0};
+    double antenna_height = 0.0;
+    uint16_t station_id = 0;
+
+    // Set whenever a new station reference position is decoded, cleared by the user
+    bool station_updated = false;
+
+    // Last MSM header, epoch time in ms of week (GLONASS uses day and time of day)
+    uint32_t epoch_time = 0;
+    bool multiple_message = false;
+
+    // Statistics
+    unsigned long station_messages = 0;
+    unsigned long msm_headers = 0;
+
+  private:
+
+    // WGS84 ECEF to latitude and longitude (deg)
+    void ecefToGeodetic(double& lat, double& lon) const
+    {
+        const double a = 6378137.0;
+        const double f = 1.0 / 298.257223563;
+        const double e2 = f * (2.0 - f);
+
+        double p = sqrt(ecef[0]*ecef[0] + ecef[1]*ecef[1]);
+        lon = atan2(ecef[1], ecef[0]);
+        lat = atan2(ecef[2], p * (1.0 - e2));
+        for (int i = 0; i < 5; i++)
+        {
+            double sin_lat = sin(lat);
+            double n = a / sqrt(1.0 - e2 * sin_lat * sin_lat);
+            double h = p / cos(lat) - n;
+            lat = atan2(ecef[2], p * (1.0 - e2 * n / (n + h)));
+        }
+
+        lat *= 180.0 / M_PI;
+        lon *= 180.0 / M_PI;
+    }
+};
+
+#endif
@@ -41,6 +41,12 @@ const char rtk_html[] PROGMEM = R"rawliteral(
       <div class="card">
         <p><i class="fas fa-clock" style="color:#1EC80D;"></i> UP TIME</p><p><span class="reading"><span id="up_time">%UP_TIME%</span> minutes</span></p>
       </div>
+      <div class="card">
+        <p><i class="fas fa-wifi" style="color:#1EC80D;"></i> WIFI OUTAGES / LONGEST (s)</p><p><span class="reading"><span id="wifi_status">%WIFI_STATUS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-stopwatch" style="color:#1EC80D;"></i> BOOT TO WIFI / IP / FIRST CORRECTION (s)</p><p><span class="reading"><span id="boot_timing">%BOOT_TIMING%</span></p>
+      </div>
       <div class="card">
         <p><i class="fa-solid fa-satellite-dish" style="color:#0B67EC;"></i> FIX TYPE</p><p><span class="reading"><span id="fix">%FIX%</span></p>
       </div>
@@ -62,6 +68,39 @@ const char rtk_html[] PROGMEM = R"rawliteral(
       <div class="card">
         <p><i class="fas fa-compass" style="color:#FFA533;"></i> UP</p><p><span class="reading"><span id="rtk_up">%RTK_UP%</span> m</span></p>
       </div>
+      <div class="card">
+        <p><i class="fas fa-times" style="color:#FFA533;"></i> BAD FRAMES</p><p><span class="reading"><span id="bad_frames">%BAD_FRAMES%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-trash" style="color:#FFA533;"></i> DROPPED BYTES</p><p><span class="reading"><span id="dropped_bytes">%DROPPED_BYTES%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-trash" style="color:#FFA533;"></i> DROPPED FRAMES</p><p><span class="reading"><span id="dropped_frames">%DROPPED_FRAMES%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-sync" style="color:#FFA533;"></i> RESYNCS</p><p><span class="reading"><span id="resyncs">%RESYNCS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-random" style="color:#FFA533;"></i> UDP LOST / REORDERED</p><p><span class="reading"><span id="udp_lost">%UDP_LOST%</span> / <span id="udp_reordered">%UDP_REORDERED%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-first-aid" style="color:#FFA533;"></i> FEC RECOVERED / FAILED</p><p><span class="reading"><span id="fec_recovered">%FEC_RECOVERED%</span> / <span id="fec_failed">%FEC_FAILED%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-stopwatch" style="color:#FFA533;"></i> <a href="latency">LATENCY P50 / P95 / P99 (ms)</a></p><p><span class="reading"><span id="latency">%LATENCY%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-search-location" style="color:#FFA533;"></i> BASE STATION</p><p><span class="reading"><span id="base_status">%BASE_STATUS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-exchange-alt" style="color:#FFA533;"></i> <a href="sources">SOURCE / SWITCHES / LAST GAP (s)</a></p><p><span class="reading"><span id="source_status">%SOURCE_STATUS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-plug" style="color:#FFA533;"></i> TCP ATTEMPTS / CONNECTS / RECONNECT (s)</p><p><span class="reading"><span id="link_status">%LINK_STATUS%</span></p>
+      </div>
+      <div class="card">
+        <p><i class="fas fa-broadcast-tower" style="color:#FFA533;"></i> NTRIP</p><p><span class="reading"><span id="ntrip_status">%NTRIP_STATUS%</span></p>
+      </div>
     </div>
   </div>
 <script>
@@ -100,6 +139,18 @@ if (!!window.EventSource)
     document.getElementById("gnss_time").innerHTML = e.data;
   }, false);
   
+  source.addEventListener('boot_timing', function(e) 
+  {
+    console.log("boot_timing", e.data);
+    document.getElementById("boot_timing").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('wifi_status', function(e) 
+  {
+    console.log("wifi_status", e.data);
+    document.getElementById("wifi_status").innerHTML = e.data;
+  }, false);
+
   source.addEventListener('up_time', function(e) 
   {
     console.log("up_time", e.data);
@@ -159,6 +210,84 @@ if (!!window.EventSource)
     console.log("rtk_up", e.data);
     document.getElementById("rtk_up").innerHTML = e.data;
   }, false);
+
+  source.addEventListener('bad_frames', function(e) 
+  {
+    console.log("bad_frames", e.data);
+    document.getElementById("bad_frames").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('dropped_bytes', function(e) 
+  {
+    console.log("dropped_bytes", e.data);
+    document.getElementById("dropped_bytes").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('dropped_frames', function(e) 
+  {
+    console.log("dropped_frames", e.data);
+    document.getElementById("dropped_frames").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('resyncs', function(e) 
+  {
+    console.log("resyncs", e.data);
+    document.getElementById("resyncs").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('udp_lost', function(e) 
+  {
+    console.log("udp_lost", e.data);
+    document.getElementById("udp_lost").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('udp_reordered', function(e) 
+  {
+    console.log("udp_reordered", e.data);
+    document.getElementById("udp_reordered").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('fec_recovered', function(e) 
+  {
+    console.log("fec_recovered", e.data);
+    document.getElementById("fec_recovered").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('fec_failed', function(e) 
+  {
+    console.log("fec_failed", e.data);
+    document.getElementById("fec_failed").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('latency', function(e) 
+  {
+    console.log("latency", e.data);
+    document.getElementById("latency").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('base_status', function(e) 
+  {
+    console.log("base_status", e.data);
+    document.getElementById("base_status").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('source_status', function(e) 
+  {
+    console.log("source_status", e.data);
+    document.getElementById("source_status").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('link_status', function(e) 
+  {
+    console.log("link_status", e.data);
+    document.getElementById("link_status").innerHTML = e.data;
+  }, false);
+
+  source.addEventListener('ntrip_status', function(e) 
+  {
+    console.log("ntrip_status", e.data);
+    document.getElementById("ntrip_status").innerHTML = e.data;
+  }, false);
 }
 </script>
 </body>
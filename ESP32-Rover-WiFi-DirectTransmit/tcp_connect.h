@@ -0,0 +1,286 @@
+/** TCP Connector
+ *  Non-blocking connection to the base station or NTRIP caster. A socket is
+ *  opened in non-blocking mode and polled from loop() until the connection
+ *  is made, then handed to a WiFiClient. Failed attempts and dropped links
+ *  are retried after a delay that doubles up to a maximum, with random
+ *  jitter so that rovers that lost the base at the same moment do not all
+ *  come back at once. Server names are looked up without blocking and the
+ *  last address found is kept for when a later lookup fails.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef TCP_CONNECT_H
+#define TCP_CONNECT_H
+
+#include <lwip/sockets.h>
+#include <fcntl.h>
+#include <esp_random.h>
+#include "dns_lookup.h"
+
+// Time allowed for the connection to be made (ms)
+#define CONNECT_TIMEOUT 5000
+
+// Delay before reconnecting, doubled after each failure up to the max (ms)
+#define CONNECT_RETRY_MIN 250
+#define CONNECT_RETRY_MAX 30000
+
+// Random part of each delay (percent)
+#define CONNECT_JITTER 25
+
+// Connection states
+#define CONNECT_WAITING 0
+#define CONNECT_PENDING 1
+#define CONNECT_CONNECTED 2
+#define CONNECT_LOOKUP 3
+
+class TCPConnector
+{
+  public:
+
+    // Set the server, host is looked up if it is not an address
+    void begin(const char* server_host, uint16_t server_port)
+    {
+        host = server_host;
+        port = server_port;
+        address = IPAddress(0, 0, 0, 0);
+        refresh = false;
+        retry_delay = CONNECT_RETRY_MIN;
+        next_attempt = 0;
+        down_since = millis();
+        state = CONNECT_WAITING;
+    }
+
+    void begin(IPAddress server_address, uint16_t server_port)
+    {
+        begin("", server_port);
+        address = server_address;
+    }
+
+    // Move the connection along, returns true once when client has just
+    // been connected
+    bool service(WiFiClient& client)
+    {
+        switch (state)
+        {
+            case CONNECT_CONNECTED:
+                if (!client.connected())
+                {
+                    Serial.print(millis());Serial.println(" Connection to server lost");
+                    client.stop();
+                    down_since = millis();
+                    retry();
+                }
+                break;
+
+            case CONNECT_WAITING:
+                if ((long)(millis() - next_attempt) >= 0)
+                    startConnect();
+                break;
+
+            case CONNECT_LOOKUP:
+                switch (lookup.poll())
+                {
+                    case LOOKUP_DONE:
+                        address = lookup.address();
+                        refresh = false;
+                        openSocket();
+                        break;
+
+                    case LOOKUP_FAILED:
+                        // Fall back on the last address found
+                        if (address == IPAddress(0, 0, 0, 0))
+                            fail("Server name lookup failed");
+                        else
+                            openSocket();
+                        break;
+                }
+                break;
+
+            case CONNECT_PENDING:
+                if (checkConnect())
+                {
+                    client = WiFiClient(sock);
+                    sock = -1;
+                    connects++;
+                    last_reconnect_time = millis() - down_since;
+                    if (last_reconnect_time > max_reconnect_time)
+                        max_reconnect_time = last_reconnect_time;
+                    retry_delay = CONNECT_RETRY_MIN;
+                    state = CONNECT_CONNECTED;
+                    return true;
+                }
+                if (millis() - attempt_time > CONNECT_TIMEOUT)
+                    fail("Connection timed out");
+                break;
+        }
+        return false;
+    }
+
+    // Change the server address, an attempt to the old address is dropped
+    // and the new one is tried straight away
+    void setServer(IPAddress server_address, uint16_t server_port)
+    {
+        if (server_address == address && server_port == port)
+            return;
+
+        host = "";
+        address = server_address;
+        port = server_port;
+        if (state == CONNECT_CONNECTED)
+            return;
+
+        if (sock >= 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+        retry_delay = CONNECT_RETRY_MIN;
+        next_attempt = millis();
+        state = CONNECT_WAITING;
+    }
+
+    // Close the connection and wait at least delay_time before the next
+    // attempt, used when the server refused the stream
+    void retryAfter(WiFiClient& client, unsigned long delay_time)
+    {
+        client.stop();
+        down_since = millis();
+        retry();
+        if ((long)(next_attempt - millis()) < (long)delay_time)
+            next_attempt = millis() + delay_time;
+    }
+
+    // Connection state for the web page
+    const char* status() const
+    {
+        switch (state)
+        {
+            case CONNECT_LOOKUP: return "Looking up";
+            case CONNECT_PENDING: return "Connecting";
+            case CONNECT_CONNECTED: return "Connected";
+            default: return "Waiting";
+        }
+    }
+
+    // Statistics
+    unsigned long attempts = 0;
+    unsigned long connects = 0;
+    unsigned long failures = 0;
+    unsigned long last_reconnect_time = 0;
+    unsigned long max_reconnect_time = 0;
+
+    // Server address, zero until a server name has been looked up
+    IPAddress serverAddress() const { return address; }
+
+  private:
+
+    // Look the server name up if needed, then start connecting
+    void startConnect()
+    {
+        attempts++;
+
+        // Names are looked up again after a failed attempt in case the
+        // server moved
+        if (host[0] != '\0' && (address == IPAddress(0, 0, 0, 0) || refresh))
+        {
+            lookup.start(host);
+            state = CONNECT_LOOKUP;
+            return;
+        }
+        openSocket();
+    }
+
+    // Open a non-blocking socket and start connecting to the server
+    void openSocket()
+    {
+        attempt_time = millis();
+
+        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (sock < 0)
+        {
+            fail("Socket failed");
+            return;
+        }
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+        struct sockaddr_in server;
+        memset(&server, 0, sizeof(server));
+        server.sin_family = AF_INET;
+        server.sin_port = htons(port);
+        server.sin_addr.s_addr = (uint32_t)address;
+
+        if (connect(sock, (struct sockaddr*)&server, sizeof(server)) < 0 && errno != EINPROGRESS)
+        {
+            fail("Connect failed");
+            return;
+        }
+
+        state = CONNECT_PENDING;
+    }
+
+    // Returns true once the connection has been made
+    bool checkConnect()
+    {
+        fd_set write_set;
+        FD_ZERO(&write_set);
+        FD_SET(sock, &write_set);
+        struct timeval no_wait = {0, 0};
+
+        if (select(sock + 1, NULL, &write_set, NULL, &no_wait) <= 0)
+            return false;
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0)
+        {
+            fail("Connect failed");
+            return false;
+        }
+        return true;
+    }
+
+    // Close a failed attempt and schedule the next one
+    void fail(const char* reason)
+    {
+        Serial.print(millis());Serial.print(" ");Serial.println(reason);
+
+        if (sock >= 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+        if (host[0] != '\0')
+            refresh = true;
+
+        failures++;
+        retry();
+    }
+
+    // Wait before the next attempt, the delay is reset by a connection
+    void retry()
+    {
+        unsigned long delay_time = retry_delay;
+        delay_time += delay_time * (esp_random() % (2 * CONNECT_JITTER + 1)) / 100;
+        delay_time -= retry_delay * CONNECT_JITTER / 100;
+        next_attempt = millis() + delay_time;
+        retry_delay = retry_delay * 2 > CONNECT_RETRY_MAX ? CONNECT_RETRY_MAX : retry_delay * 2;
+        state = CONNECT_WAITING;
+    }
+
+    const char* host = "";
+    uint16_t port = 0;
+    IPAddress address;
+    DNSLookup lookup;
+    bool refresh = false;
+
+    int sock = -1;
+    uint8_t state = CONNECT_WAITING;
+    unsigned long attempt_time = 0;
+    unsigned long next_attempt = 0;
+    unsigned long retry_delay = CONNECT_RETRY_MIN;
+    unsigned long down_since = 0;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/** UART Transmit Ring
+ *  Byte ring holding checked correction frames until the GNSS receiver's
+ *  UART can take them. Frames are copied in whole and drained in blocks of
+ *  whatever the UART transmit FIFO has room for, so loop() never waits on
+ *  the serial port. Read and write positions count bytes since startup so
+ *  a frame can be followed to the moment its last byte leaves the ring.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef UART_TX_RING_H
+#define UART_TX_RING_H
+
+// Size of the ring (bytes, power of two)
+#define UART_TX_RING_SIZE 8192
+
+class UARTTxRing
+{
+  public:
+
+    // Add a frame, returns false and drops it if there is not room for all
+    // of it
+    bool write(const uint8_t* data, uint32_t length)
+    {
+        if (length > space())
+        {
+            frames_dropped++;
+            return false;
+        }
+
+        uint32_t index = head % UART_TX_RING_SIZE;
+        uint32_t first = UART_TX_RING_SIZE - index;
+        if (first > length)
+            first = length;
+        memcpy(buffer + index, data, first);
+        memcpy(buffer, data + first, length - first);
+        head += length;
+
+        if (head - tail > high_water)
+            high_water = head - tail;
+        return true;
+    }
+
+    // Write as much as the serial port can take without blocking, returns
+    // the number of bytes written
+    uint32_t drain(HardwareSerial& serial)
+    {
+        uint32_t written = 0;
+        int room = serial.availableForWrite();
+        while (room > 0 && head != tail)
+        {
+            // Contiguous bytes from the tail
+            uint32_t index = tail % UART_TX_RING_SIZE;
+            uint32_t length = head - tail;
+            if (length > UART_TX_RING_SIZE - index)
+                length = UART_TX_RING_SIZE - index;
+            if (length > (uint32_t)room)
+                length = room;
+
+            length = serial.write(buffer + index, length);
+            if (length == 0)
+                break;
+            tail += length;
+            written += length;
+            room -= length;
+        }
+        return written;
+    }
+
+    // Free space (bytes)
+    uint32_t space() const { return UART_TX_RING_SIZE - (head - tail); }
+
+    // Bytes added and bytes written to the serial port since startup
+    uint32_t writePosition() const { return head; }
+    uint32_t readPosition() const { return tail; }
+
+    // Statistics
+    uint32_t high_water = 0;
+    unsigned long frames_dropped = 0;
+
+  private:
+
+    uint8_t buffer[UART_TX_RING_SIZE];
+    uint32_t head = 0;
+    uint32_t tail = 0;
+};
+
+#endif
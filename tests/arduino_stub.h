@@ -0,0 +1,59 @@
+/** Arduino Stub
+ *  The few Arduino calls used by the headers under test, so they can be
+ *  built and run on the host. millis() and micros() follow fake_time (us),
+ *  which the tests move forward.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef ARDUINO_STUB_H
+#define ARDUINO_STUB_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <strings.h>
+
+uint64_t fake_time = 0;
+
+unsigned long millis() { return fake_time / 1000; }
+unsigned long micros() { return fake_time; }
+
+class String : public std::string
+{
+  public:
+    String(const char* text = "") : std::string(text) {}
+    String(const std::string& text) : std::string(text) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned int value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+    String(double value, int decimals = 2)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", decimals, value);
+        assign(text);
+    }
+
+    void trim()
+    {
+        size_t start = find_first_not_of(" \t\r\n");
+        size_t end = find_last_not_of(" \t\r\n");
+        assign(start == npos ? "" : substr(start, end - start + 1));
+    }
+};
+
+class SerialStub
+{
+  public:
+    template <typename T> void print(T) {}
+    template <typename T> void println(T) {}
+    void println() {}
+};
+SerialStub Serial;
+
+#endif
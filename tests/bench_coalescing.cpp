@@ -0,0 +1,141 @@
+/** Write Coalescing Replay
+ *  Replays one second epochs arriving over the base UART through the
+ *  correction ring and the client write policy of sendToClients(), polled
+ *  once a ms like loop(). For each hold limit it reports writes and TCP
+ *  segments per epoch and how long frames wait between their last byte
+ *  arriving from the UART and being written to the socket. "per frame"
+ *  writes every frame as soon as it is stored, "epoch" never sends before
+ *  the end of the epoch.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_decoder.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/correction_ring.h"
+
+#define REPLAY_EPOCHS 600
+#define TCP_SEGMENT 1460
+#define NO_HOLD_LIMIT 0xFFFFFFFF
+
+CorrectionRing correction_ring;
+
+// Frame and the time its last byte arrives from the UART (us)
+struct ReplayFrame
+{
+    std::vector<uint8_t> data;
+    uint64_t time;
+};
+
+// As coalescedLength() in the sketch, with the hold limit (ms) as a
+// parameter, 0 sends every frame as soon as it is stored
+uint32_t coalescedLength(const RingCursor& cursor, uint32_t max_delay)
+{
+    uint32_t pending = correction_ring.pending(cursor);
+    if (pending == 0)
+        return 0;
+    if (max_delay != NO_HOLD_LIMIT && fake_time - correction_ring.frame(cursor.frame).time >= max_delay * 1000UL)
+        return pending;
+    return correction_ring.pendingBefore(cursor, correction_ring.epochFrame());
+}
+
+// Epochs of a 1005, a 1230 and four MSM7 messages sent back to back at the
+// baud rate, last byte times in us
+std::vector<ReplayFrame> makeReplay(uint32_t baud)
+{
+    std::vector<ReplayFrame> replay;
+    double byte_time = 10.0 * 1e6 / baud;
+    for (int epoch = 0; epoch < REPLAY_EPOCHS; epoch++)
+    {
+        uint64_t time = 1000000ULL * (epoch + 1);
+        std::vector<std::vector<uint8_t>> frames;
+        frames.push_back(rtcm1005(-2694892.4614, -4297418.1926, 3854363.6023));
+        frames.push_back(rtcmMessage(1230, 8));
+        const uint16_t msm[] = {1077, 1087, 1097, 1127};
+        for (int i = 0; i < 4; i++)
+            frames.push_back(rtcmMSM(msm[i], epoch * 1000, i < 3, 150 + rand() % 150));
+
+        for (const std::vector<uint8_t>& frame : frames)
+        {
+            time += frame.size() * byte_time;
+            replay.push_back({frame, time});
+        }
+    }
+    return replay;
+}
+
+void run(const std::vector<ReplayFrame>& replay, uint32_t max_delay)
+{
+    correction_ring = CorrectionRing();
+    RTCMDecoder decoder;
+    RingCursor cursor;
+    correction_ring.attach(cursor);
+
+    unsigned long writes = 0;
+    unsigned long segments = 0;
+    unsigned long frames = 0;
+    uint64_t hold_total = 0;
+    uint64_t hold_max = 0;
+    size_t next = 0;
+    uint64_t end = replay.back().time + 1000000;
+    for (fake_time = 0; fake_time < end; fake_time += 1000)
+    {
+        // Frames completed since the last pass
+        while (next < replay.size() && replay[next].time <= fake_time)
+        {
+            const std::vector<uint8_t>& frame = replay[next].data;
+            uint16_t message_type = decoder.decode(frame.data(), frame.size());
+            bool end_of_epoch = rtcmIsMSM(message_type) && !decoder.multiple_message;
+            correction_ring.push(frame.data(), frame.size(), message_type, replay[next].time, end_of_epoch);
+            next++;
+        }
+
+        uint32_t ready = coalescedLength(cursor, max_delay);
+        if (ready == 0)
+            continue;
+
+        writes++;
+        segments += (ready + TCP_SEGMENT - 1) / TCP_SEGMENT;
+        uint32_t end_frame = cursor.frame;
+        while (correction_ring.pendingBefore(cursor, end_frame) < ready)
+            end_frame++;
+        for (uint32_t frame = cursor.frame; frame != end_frame; frame++)
+        {
+            uint64_t hold = fake_time - correction_ring.frame(frame).time;
+            hold_total += hold;
+            if (hold > hold_max)
+                hold_max = hold;
+            frames++;
+        }
+        correction_ring.advance(cursor, ready);
+    }
+    CHECK(frames == replay.size());
+
+    char label[16];
+    if (max_delay == NO_HOLD_LIMIT)
+        snprintf(label, sizeof(label), "epoch");
+    else if (max_delay == 0)
+        snprintf(label, sizeof(label), "per frame");
+    else
+        snprintf(label, sizeof(label), "%u ms", max_delay);
+    printf("  %-10s %6.2f %6.2f %9.2f %9.2f\n", label, (double)writes / REPLAY_EPOCHS,
+           (double)segments / REPLAY_EPOCHS, hold_total / 1000.0 / frames, hold_max / 1000.0);
+}
+
+int main()
+{
+    crc24qInit();
+    srand(13);
+
+    const uint32_t bauds[] = {115200, 460800, 921600};
+    const uint32_t delays[] = {0, 5, 20, 50, NO_HOLD_LIMIT};
+    for (uint32_t baud : bauds)
+    {
+        std::vector<ReplayFrame> replay = makeReplay(baud);
+        printf("%u baud, per epoch: writes, segments, frame hold mean / max (ms)\n", baud);
+        for (uint32_t max_delay : delays)
+            run(replay, max_delay);
+    }
+
+    return testResult("coalescing replay");
+}
@@ -0,0 +1,89 @@
+/** CRC-24Q Benchmark
+ *  Host time to validate RTCM frames with crc24q(), the slicing-by-4 table
+ *  version both sketches use, against a bit at a time reference and a
+ *  single table byte at a time version. Reported per 1 KB block and per
+ *  byte for the frame lengths the base and rover see, from a short station
+ *  message to the largest frame. All three must agree on every length and
+ *  give the standard check value for "123456789".
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include <chrono>
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_framer.h"
+
+#define BENCH_BYTES (64 * 1024 * 1024)
+
+// One bit at a time from the polynomial, no tables
+uint32_t crc24qBitwise(const uint8_t* data, uint16_t length)
+{
+    uint32_t crc = 0;
+    while (length--)
+    {
+        crc ^= (uint32_t)*data++ << 16;
+        for (int j = 0; j < 8; j++)
+        {
+            crc <<= 1;
+            if (crc & 0x1000000UL)
+                crc ^= 0x1864CFBUL;
+        }
+    }
+    return crc & 0xFFFFFF;
+}
+
+// One table lookup per byte, the tail loop of crc24q() on its own
+uint32_t crc24qBytewise(const uint8_t* data, uint16_t length)
+{
+    uint32_t crc = 0;
+    while (length--)
+        crc = (crc << 8) ^ crc24q_table[0][(crc >> 24) ^ *data++];
+    return crc >> 8;
+}
+
+// Host time per byte (ns) to check blocks of the given length
+double timeCRC(uint32_t (*crc)(const uint8_t*, uint16_t), const std::vector<uint8_t>& block,
+               uint16_t length)
+{
+    unsigned long runs = BENCH_BYTES / length;
+    volatile uint32_t result = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < runs; i++)
+        result = result ^ crc(block.data() + (i & 3), length);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / ((double)runs * length);
+}
+
+int main()
+{
+    crc24qInit();
+    srand(29);
+
+    std::vector<uint8_t> block(RTCM_MAX_FRAME_LENGTH + 4);
+    for (uint8_t& ch : block)
+        ch = rand();
+
+    // Standard check value and agreement on every length and alignment
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    CHECK(crc24q(check, sizeof(check)) == 0xCDE703);
+    CHECK(crc24qBitwise(check, sizeof(check)) == 0xCDE703);
+    for (uint16_t length = 0; length <= RTCM_MAX_FRAME_LENGTH; length++)
+    {
+        uint32_t expected = crc24qBitwise(block.data() + (length & 3), length);
+        CHECK(crc24q(block.data() + (length & 3), length) == expected);
+        CHECK(crc24qBytewise(block.data() + (length & 3), length) == expected);
+    }
+
+    printf("host time per byte (ns) and per 1 KB (us)\n");
+    printf("length   bitwise  bytewise  sliced   sliced per KB\n");
+    const uint16_t lengths[] = {25, 200, 1024, RTCM_MAX_FRAME_LENGTH};
+    for (uint16_t length : lengths)
+    {
+        double bitwise = timeCRC(crc24qBitwise, block, length);
+        double bytewise = timeCRC(crc24qBytewise, block, length);
+        double sliced = timeCRC(crc24q, block, length);
+        printf("%6u  %8.2f  %8.2f  %6.2f  %14.2f\n", length, bitwise, bytewise, sliced, sliced * 1024 / 1000.0);
+    }
+
+    return testResult("crc24q");
+}
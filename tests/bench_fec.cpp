@@ -0,0 +1,88 @@
+/** UDP FEC Simulation
+ *  Frames delivered to the receiver and complete epochs at random datagram
+ *  loss, without parity and with parity groups of 2, 4 and 8 frames. Each
+ *  epoch is six frames and closes its parity group, as on the base station.
+ *  Every delivered frame is checked against the frame that was sent.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "udp_harness.h"
+
+#define SIM_EPOCHS 4000
+#define SIM_EPOCH_FRAMES 6
+
+// Epoch of MSM sized frames with a 1005 first
+std::vector<std::vector<uint8_t>> makeEpochs()
+{
+    std::vector<std::vector<uint8_t>> frames;
+    for (int epoch = 0; epoch < SIM_EPOCHS; epoch++)
+    {
+        frames.push_back(rtcmMessage(1005, 19));
+        for (int i = 1; i < SIM_EPOCH_FRAMES; i++)
+            frames.push_back(rtcmMessage(1074 + 10 * i, 120 + rand() % 120));
+    }
+    return frames;
+}
+
+int main()
+{
+    crc24qInit();
+    srand(11);
+
+    std::vector<std::vector<uint8_t>> frames = makeEpochs();
+    const double losses[] = {0.01, 0.02, 0.05, 0.10, 0.20};
+    const uint8_t groups[] = {0, 2, 4, 8};
+
+    printf("%d frames in %d frame epochs, delivered frames / complete epochs (%%)\n",
+           SIM_EPOCHS * SIM_EPOCH_FRAMES, SIM_EPOCH_FRAMES);
+    printf("loss    no FEC           K=2              K=4              K=8\n");
+    for (double loss : losses)
+    {
+        printf("%4.0f%%", loss * 100.0);
+        for (uint8_t group : groups)
+        {
+            std::vector<Datagram> datagrams = sendFrames(frames, 0, group, SIM_EPOCH_FRAMES);
+            Rover rover;
+            for (const Datagram& datagram : datagrams)
+            {
+                if (rand() < loss * ((double)RAND_MAX + 1.0))
+                    continue;
+                rover.receive(datagram);
+            }
+            rover.fec.finishGroup();
+            rover.drain();
+
+            // Delivered frames must be the sent frames in order, an epoch
+            // is complete when all of its frames were delivered
+            size_t sent = 0;
+            unsigned long epochs = 0;
+            int epoch_frames = 0;
+            int epoch = -1;
+            for (const std::vector<uint8_t>& frame : rover.written)
+            {
+                while (sent < frames.size() && frames[sent] != frame)
+                    sent++;
+                CHECK(sent < frames.size());
+                if (sent >= frames.size())
+                    break;
+
+                int frame_epoch = sent / SIM_EPOCH_FRAMES;
+                if (frame_epoch != epoch)
+                {
+                    epoch = frame_epoch;
+                    epoch_frames = 0;
+                }
+                if (++epoch_frames == SIM_EPOCH_FRAMES)
+                    epochs++;
+                sent++;
+            }
+
+            printf("   %6.2f / %6.2f", 100.0 * rover.written.size() / frames.size(),
+                   100.0 * epochs / SIM_EPOCHS);
+        }
+        printf("\n");
+    }
+
+    return testResult("fec simulation");
+}
@@ -0,0 +1,139 @@
+/** Base Forwarding Latency Benchmark
+ *  Replays 1 Hz bursts of RTCM frames arriving over the base UART and
+ *  reports, per message type, the time from the last byte of a frame
+ *  leaving the receiver to the frame being written to the rovers. The idle
+ *  gap path is the original readSerialBufferAndSend(), which waits for
+ *  50 ms of silence and writes the whole burst. The framer path is the
+ *  RTCMFramer the base uses now, fed the bytes that arrived since the last
+ *  loop() pass, one pass a ms. The host time the framer takes per byte is
+ *  reported as well.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include <chrono>
+#include <map>
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_framer.h"
+
+#define REPLAY_BURSTS 600
+#define UART_BAUD 115200
+#define IDLE_GAP 50000
+#define LOOP_PERIOD 1000
+
+// Byte and the time it arrives from the UART (us)
+struct UARTByte
+{
+    uint8_t data;
+    uint64_t time;
+};
+
+// Frame with the times of its first and last bytes
+struct BurstFrame
+{
+    uint16_t message_type;
+    uint64_t start;
+    uint64_t time;
+};
+
+struct Latency
+{
+    unsigned long count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    void add(uint64_t latency)
+    {
+        count++;
+        total += latency;
+        if (latency > max)
+            max = latency;
+    }
+};
+
+int main()
+{
+    crc24qInit();
+    srand(19);
+
+    // Station position, antenna and MSM7 messages for four constellations,
+    // sent back to back once a second
+    std::vector<UARTByte> bytes;
+    std::vector<BurstFrame> frames;
+    double byte_time = 10.0 * 1e6 / UART_BAUD;
+    for (int burst = 0; burst < REPLAY_BURSTS; burst++)
+    {
+        double time = 1e6 * (burst + 1);
+        const uint16_t types[] = {1005, 1033, 1077, 1087, 1097, 1127};
+        for (uint16_t message_type : types)
+        {
+            std::vector<uint8_t> frame = message_type == 1005 ? rtcm1005(-2694892.4614, -4297418.1926, 3854363.6023)
+                                       : message_type == 1033 ? rtcmMessage(1033, 40)
+                                       : rtcmMSM(message_type, burst * 1000, message_type != 1127, 150 + rand() % 150);
+            uint64_t start = time + byte_time;
+            for (uint8_t ch : frame)
+            {
+                time += byte_time;
+                bytes.push_back({ch, (uint64_t)time});
+            }
+            frames.push_back({message_type, start, (uint64_t)time});
+        }
+    }
+
+    // Idle gap: a burst ends with a frame followed by IDLE_GAP of silence
+    // and is written then
+    std::map<uint16_t, Latency> idle_gap;
+    for (size_t first = 0; first < frames.size();)
+    {
+        size_t last = first;
+        while (last + 1 < frames.size() && frames[last + 1].start - frames[last].time < IDLE_GAP)
+            last++;
+        uint64_t write_time = frames[last].time + IDLE_GAP;
+        for (; first <= last; first++)
+            idle_gap[frames[first].message_type].add(write_time - frames[first].time);
+    }
+
+    // Framer: the bytes that arrived before each loop pass, a frame is
+    // written in the pass that completes it
+    std::map<uint16_t, Latency> framed;
+    RTCMFramer framer;
+    size_t next = 0;
+    size_t frame = 0;
+    uint64_t end = bytes.back().time + LOOP_PERIOD;
+    for (uint64_t now = 0; now <= end; now += LOOP_PERIOD)
+    {
+        for (; next < bytes.size() && bytes[next].time <= now; next++)
+        {
+            if (!framer.addByte(bytes[next].data))
+                continue;
+            CHECK(frame < frames.size() && framer.messageType() == frames[frame].message_type);
+            framed[frames[frame].message_type].add(now - frames[frame].time);
+            frame++;
+        }
+    }
+    CHECK(frame == frames.size());
+
+    printf("%d bursts at %d baud, latency per frame mean / max (ms)\n", REPLAY_BURSTS, UART_BAUD);
+    printf("type   idle gap          framer\n");
+    for (auto& entry : idle_gap)
+    {
+        const Latency& before = entry.second;
+        const Latency& after = framed[entry.first];
+        CHECK(before.count == after.count);
+        printf("%4u   %6.1f / %6.1f   %5.2f / %5.2f\n", entry.first, before.total / 1000.0 / before.count,
+               before.max / 1000.0, after.total / 1000.0 / after.count, after.max / 1000.0);
+    }
+
+    // Framer cost on the host
+    RTCMFramer timed;
+    auto start = std::chrono::steady_clock::now();
+    unsigned long found = 0;
+    for (int pass = 0; pass < 10; pass++)
+        for (const UARTByte& byte : bytes)
+            found += timed.addByte(byte.data);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    CHECK(found == 10 * frames.size());
+    printf("framer: %.1f ns per byte on the host\n", ns / (10.0 * bytes.size()));
+
+    return testResult("framer latency");
+}
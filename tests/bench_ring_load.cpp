@@ -0,0 +1,113 @@
+/** Correction Ring Load Test
+ *  One hour of 1 Hz epochs fanned out from the correction ring to 1, 4 and
+ *  8 simulated rovers, read through their cursors in socket sized writes as
+ *  sendToClients() does. Reports host throughput and the memory used: the
+ *  ring and cursors are fixed in size and nothing is allocated while
+ *  frames flow, where a copy per client would grow with the number of
+ *  rovers. Every rover must receive every byte in order.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include <chrono>
+#include <new>
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/correction_ring.h"
+
+#define LOAD_EPOCHS 3600
+#define TCP_SEGMENT 1460
+
+// Heap allocated since the counter was last cleared
+size_t heap_allocated = 0;
+
+void* operator new(size_t size)
+{
+    heap_allocated += size;
+    void* block = malloc(size);
+    if (block == NULL)
+        throw std::bad_alloc();
+    return block;
+}
+
+void operator delete(void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+
+CorrectionRing correction_ring;
+
+int main()
+{
+    crc24qInit();
+    srand(17);
+
+    // Epochs of a station message and four MSM frames
+    std::vector<std::vector<uint8_t>> frames;
+    size_t total_bytes = 0;
+    for (int epoch = 0; epoch < LOAD_EPOCHS; epoch++)
+    {
+        frames.push_back(rtcmMessage(1005, 19));
+        for (int i = 0; i < 4; i++)
+            frames.push_back(rtcmMessage(1077 + 10 * i, 150 + rand() % 150));
+    }
+    for (const std::vector<uint8_t>& frame : frames)
+        total_bytes += frame.size();
+
+    printf("%d epochs, %zu bytes\n", LOAD_EPOCHS, total_bytes);
+    printf("rovers  ingest MB/s  sent MB/s  ring + cursors (B)  copy per rover (B)  heap in run (B)\n");
+    const int rover_counts[] = {1, 4, 8};
+    for (int rovers : rover_counts)
+    {
+        correction_ring = CorrectionRing();
+        std::vector<RingCursor> cursors(rovers);
+        std::vector<uint32_t> checksums(rovers, 0);
+        std::vector<size_t> received(rovers, 0);
+        for (RingCursor& cursor : cursors)
+            correction_ring.attach(cursor);
+
+        heap_allocated = 0;
+        auto start = std::chrono::steady_clock::now();
+        size_t next = 0;
+        for (int epoch = 0; epoch < LOAD_EPOCHS; epoch++)
+        {
+            for (int i = 0; i < 5; i++, next++)
+                correction_ring.push(frames[next].data(), frames[next].size(), 0, 0, i == 4);
+
+            // Each rover takes up to one segment a write, as a socket with
+            // room in its send buffer
+            for (int r = 0; r < rovers; r++)
+            {
+                RingCursor& cursor = cursors[r];
+                uint32_t length;
+                const uint8_t* data;
+                while ((data = correction_ring.peek(cursor, length)) != NULL)
+                {
+                    if (length > TCP_SEGMENT)
+                        length = TCP_SEGMENT;
+                    for (uint32_t n = 0; n < length; n++)
+                        checksums[r] = checksums[r] * 31 + data[n];
+                    received[r] += length;
+                    correction_ring.advance(cursor, length);
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t heap = heap_allocated;
+
+        uint32_t expected = 0;
+        for (const std::vector<uint8_t>& frame : frames)
+            for (uint8_t ch : frame)
+                expected = expected * 31 + ch;
+        for (int r = 0; r < rovers; r++)
+        {
+            CHECK(received[r] == total_bytes);
+            CHECK(checksums[r] == expected);
+            CHECK(cursors[r].frames_missed == 0);
+        }
+        CHECK(heap == 0);
+
+        printf("%6d  %11.1f  %9.1f  %18zu  %18zu  %15zu\n", rovers, total_bytes / seconds / 1e6,
+               rovers * total_bytes / seconds / 1e6, sizeof(CorrectionRing) + rovers * sizeof(RingCursor),
+               (size_t)rovers * RING_DATA_SIZE, heap);
+    }
+
+    return testResult("ring load");
+}
@@ -0,0 +1,204 @@
+/** TCP to UART Read Benchmark
+ *  Rover pass-through from a fake socket to a fake UART, bytes per us of
+ *  host time. The per-byte path is the original readAndSendTCPData(), one
+ *  read() call per byte into a 2500 byte array written straight to the
+ *  UART. The block path reads a TCP segment at a time, frames it with
+ *  RTCMFramer::addBytes() and drains it through the UARTTxRing, as the
+ *  sketch does now. The NTRIP decoding of a chunked v2 stream is compared
+ *  the same way, NtripResponse::addByte() against addBytes() in place.
+ *  Both paths must give the receiver the same bytes.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include <chrono>
+#include "rtcm_test.h"
+
+// Serial port that takes everything offered, keeping what it was sent
+class HardwareSerial
+{
+  public:
+    int availableForWrite() { return 4096; }
+    size_t write(const uint8_t* data, size_t length)
+    {
+        output.insert(output.end(), data, data + length);
+        return length;
+    }
+    std::vector<uint8_t> output;
+};
+
+#include "../ESP32-Rover-WiFi-DirectTransmit/rtcm_framer.h"
+#include "../ESP32-Rover-WiFi-DirectTransmit/uart_tx_ring.h"
+#include "../ESP32-Rover-WiFi-DirectTransmit/ntrip_client.h"
+
+#define BENCH_BYTES (10 * 1024 * 1024)
+#define MAX_SERIAL_LENGTH 2500
+#define TCP_READ_SIZE 1460
+
+// Socket holding a stream that arrives in TCP segments of up to 1460 bytes
+class FakeClient
+{
+  public:
+    FakeClient(const std::vector<uint8_t>& stream) : data(stream) {}
+
+    // Next segment has arrived
+    bool receive()
+    {
+        if (end == data.size())
+            return false;
+        end += 200 + rand() % 1261;
+        if (end > data.size())
+            end = data.size();
+        return true;
+    }
+
+    // Not inlined, like the calls into the WiFi library on the ESP32
+    __attribute__((noinline)) int available() { return end - position; }
+    __attribute__((noinline)) int read() { return position < end ? data[position++] : -1; }
+    __attribute__((noinline)) int read(uint8_t* buffer, size_t length)
+    {
+        if (length > end - position)
+            length = end - position;
+        memcpy(buffer, data.data() + position, length);
+        position += length;
+        return length;
+    }
+
+  private:
+    const std::vector<uint8_t>& data;
+    size_t position = 0;
+    size_t end = 0;
+};
+
+// Original loop body, a byte at a time
+void readPerByte(FakeClient& client, HardwareSerial& serial)
+{
+    unsigned long i = 0;
+    char rtcm_data[MAX_SERIAL_LENGTH];
+    while (client.available())
+    {
+        rtcm_data[i] = client.read();
+        i++;
+        if (i >= MAX_SERIAL_LENGTH)
+            break;
+    }
+    if (i > 0)
+        serial.write((uint8_t*)rtcm_data, i);
+}
+
+// Current loop body, a segment at a time through the framer and the ring
+void readBlock(FakeClient& client, RTCMFramer& framer, UARTTxRing& ring, HardwareSerial& serial)
+{
+    uint8_t data[TCP_READ_SIZE];
+    while (client.available() > 0 && ring.space() >= TCP_READ_SIZE + RTCM_MAX_FRAME_LENGTH)
+    {
+        int length = client.read(data, sizeof(data));
+        uint32_t used = 0;
+        do
+        {
+            used += framer.addBytes(data + used, length - used);
+            if (framer.frameLength() != 0)
+                ring.write(framer.frame(), framer.frameLength());
+        } while (used < (uint32_t)length || framer.frameLength() != 0);
+    }
+    ring.drain(serial);
+}
+
+double bytesPerMicrosecond(size_t bytes, std::chrono::steady_clock::time_point start)
+{
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return bytes / us;
+}
+
+// Chunked NTRIP v2 response carrying the stream
+std::vector<uint8_t> ntripStream(const std::vector<uint8_t>& stream)
+{
+    std::string text = "HTTP/1.1 200 OK\r\nNtrip-Version: Ntrip/2.0\r\nTransfer-Encoding: chunked\r\n\r\n";
+    std::vector<uint8_t> response(text.begin(), text.end());
+    for (size_t i = 0; i < stream.size();)
+    {
+        size_t chunk = 100 + rand() % 1000;
+        if (chunk > stream.size() - i)
+            chunk = stream.size() - i;
+        char size[16];
+        int n = snprintf(size, sizeof(size), "%zx\r\n", chunk);
+        response.insert(response.end(), size, size + n);
+        response.insert(response.end(), stream.begin() + i, stream.begin() + i + chunk);
+        response.push_back('\r');
+        response.push_back('\n');
+        i += chunk;
+    }
+    return response;
+}
+
+int main()
+{
+    crc24qInit();
+    srand(5);
+
+    std::vector<uint8_t> stream;
+    while (stream.size() < BENCH_BYTES)
+    {
+        std::vector<uint8_t> frame = rtcmMessage(1074 + 10 * (rand() % 4), 20 + rand() % 400);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    // Raw TCP stream from the base station
+    HardwareSerial per_byte_serial;
+    {
+        srand(9);
+        FakeClient client(stream);
+        auto start = std::chrono::steady_clock::now();
+        while (client.receive())
+            readPerByte(client, per_byte_serial);
+        printf("per-byte read:  %6.1f B/us\n", bytesPerMicrosecond(stream.size(), start));
+    }
+
+    HardwareSerial block_serial;
+    {
+        srand(9);
+        FakeClient client(stream);
+        RTCMFramer framer;
+        static UARTTxRing ring;
+        auto start = std::chrono::steady_clock::now();
+        while (client.receive())
+            readBlock(client, framer, ring, block_serial);
+        printf("block read:     %6.1f B/us\n", bytesPerMicrosecond(stream.size(), start));
+        CHECK(ring.frames_dropped == 0);
+    }
+    CHECK(per_byte_serial.output == stream);
+    CHECK(block_serial.output == stream);
+
+    // Chunked NTRIP v2 stream, decoding only
+    std::vector<uint8_t> response = ntripStream(stream);
+    {
+        NtripResponse ntrip;
+        ntrip.reset();
+        std::vector<uint8_t> output;
+        output.reserve(stream.size());
+        auto start = std::chrono::steady_clock::now();
+        for (uint8_t ch : response)
+            if (ntrip.addByte(ch))
+                output.push_back(ch);
+        printf("NTRIP per-byte: %6.1f B/us\n", bytesPerMicrosecond(response.size(), start));
+        CHECK(output == stream);
+    }
+    {
+        NtripResponse ntrip;
+        ntrip.reset();
+        std::vector<uint8_t> output;
+        output.reserve(stream.size());
+        std::vector<uint8_t> copy = response;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < copy.size(); i += TCP_READ_SIZE)
+        {
+            uint32_t length = copy.size() - i < TCP_READ_SIZE ? copy.size() - i : TCP_READ_SIZE;
+            uint32_t kept = ntrip.addBytes(copy.data() + i, length);
+            output.insert(output.end(), copy.data() + i, copy.data() + i + kept);
+        }
+        printf("NTRIP block:    %6.1f B/us\n", bytesPerMicrosecond(response.size(), start));
+        CHECK(output == stream);
+    }
+
+    return testResult("uart read benchmark");
+}
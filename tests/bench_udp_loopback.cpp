@@ -0,0 +1,168 @@
+/** UDP Loopback Test
+ *  Sends correction datagrams over real UDP sockets on 127.0.0.1 and reads
+ *  them back as the rover does, counting losses and reordering from the
+ *  sequence numbers and measuring the time from the header timestamp to
+ *  the datagram being read. Paced epochs are read back after each epoch,
+ *  a burst is sent in full before reading into a receive buffer the size of
+ *  a small lwIP one, to show the loss when the rover falls behind.
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_framer.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/correction_udp.h"
+
+#define LOOPBACK_EPOCHS 2000
+#define BURST_EPOCHS 400
+#define EPOCH_FRAMES 6
+#define RECEIVE_BUFFER 16384
+
+uint32_t clockMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Loopback
+{
+  public:
+
+    bool open()
+    {
+        receiver = socket(AF_INET, SOCK_DGRAM, 0);
+        sender = socket(AF_INET, SOCK_DGRAM, 0);
+        if (receiver < 0 || sender < 0)
+            return false;
+
+        int size = RECEIVE_BUFFER;
+        setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        fcntl(receiver, F_SETFL, fcntl(receiver, F_GETFL, 0) | O_NONBLOCK);
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        return bind(receiver, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+               getsockname(receiver, (struct sockaddr*)&address, &length) == 0;
+    }
+
+    void close()
+    {
+        ::close(receiver);
+        ::close(sender);
+    }
+
+    // Send a frame in a datagram as the base does
+    void send(const std::vector<uint8_t>& frame, uint16_t epoch)
+    {
+        uint8_t datagram[UDP_HEADER_LENGTH + RTCM_MAX_FRAME_LENGTH];
+        UDPHeader header = {0, sequence++, epoch, 0, 0, clockMicros()};
+        packUDPHeader(datagram, header);
+        memcpy(datagram + UDP_HEADER_LENGTH, frame.data(), frame.size());
+        sendto(sender, datagram, UDP_HEADER_LENGTH + frame.size(), 0, (struct sockaddr*)&address,
+               sizeof(address));
+        sent++;
+    }
+
+    // Read every waiting datagram as readAndSendUDPData() does
+    void receive()
+    {
+        uint8_t datagram[UDP_HEADER_LENGTH + RTCM_MAX_FRAME_LENGTH];
+        int length;
+        while ((length = recv(receiver, datagram, sizeof(datagram), 0)) > 0)
+        {
+            uint32_t now = clockMicros();
+            UDPHeader header;
+            if (!parseUDPHeader(datagram, length, header) || !tracker.update(header.sequence))
+                continue;
+            latencies.push_back(now - header.timestamp);
+
+            uint16_t used = 0;
+            do
+            {
+                used += framer.addBytes(datagram + UDP_HEADER_LENGTH + used, length - UDP_HEADER_LENGTH - used);
+            } while (used < length - UDP_HEADER_LENGTH || framer.frameLength() != 0);
+        }
+    }
+
+    void report(const char* name)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        uint32_t p50 = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+        uint32_t p99 = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+        uint32_t max = latencies.empty() ? 0 : latencies.back();
+        printf("%-7s %6lu %8lu %6lu %9lu %6u %6u %7u\n", name, sent, tracker.received, tracker.lost,
+               tracker.reordered, p50, p99, max);
+    }
+
+    unsigned long sent = 0;
+    UDPSequenceTracker tracker;
+    RTCMFramer framer;
+    std::vector<uint32_t> latencies;
+
+  private:
+
+    int receiver = -1;
+    int sender = -1;
+    struct sockaddr_in address;
+    uint32_t sequence = 0;
+};
+
+int main()
+{
+    crc24qInit();
+    srand(23);
+
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < EPOCH_FRAMES; i++)
+        frames.push_back(rtcmMessage(1077 + 10 * i, 150 + rand() % 150));
+
+    printf("run       sent received   lost reordered    p50    p99     max (us)\n");
+
+    // Paced epochs, read back after each one
+    Loopback paced;
+    if (!paced.open())
+    {
+        printf("UDP loopback not available\n");
+        return 1;
+    }
+    for (int epoch = 0; epoch < LOOPBACK_EPOCHS; epoch++)
+    {
+        for (const std::vector<uint8_t>& frame : frames)
+            paced.send(frame, epoch);
+        paced.receive();
+    }
+    paced.receive();
+    paced.report("paced");
+    CHECK(paced.tracker.received + paced.tracker.lost == paced.sent);
+    CHECK(paced.framer.frames_received == paced.tracker.received);
+    CHECK(paced.framer.frames_failed == 0);
+    paced.close();
+
+    // Burst larger than the receive buffer, read back afterwards
+    Loopback burst;
+    CHECK(burst.open());
+    for (int epoch = 0; epoch < BURST_EPOCHS; epoch++)
+        for (const std::vector<uint8_t>& frame : frames)
+            burst.send(frame, epoch);
+    burst.receive();
+
+    // Losses at the end of the burst are seen when the next epoch arrives
+    for (const std::vector<uint8_t>& frame : frames)
+        burst.send(frame, BURST_EPOCHS);
+    burst.receive();
+    burst.report("burst");
+    CHECK(burst.tracker.received + burst.tracker.lost == burst.sent);
+    CHECK(burst.framer.frames_received == burst.tracker.received);
+    CHECK(burst.framer.frames_failed == 0);
+    burst.close();
+
+    return testResult("udp loopback");
+}
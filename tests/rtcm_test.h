@@ -0,0 +1,90 @@
+/** RTCM Test Helpers
+ *  Build RTCM3 frames and check results in the host tests
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef RTCM_TEST_H
+#define RTCM_TEST_H
+
+#include <vector>
+#include "arduino_stub.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/crc24q.h"
+
+int test_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); test_failures++; } } while (0)
+
+// Result line and exit code for main()
+int testResult(const char* name)
+{
+    printf("%s: %s\n", name, test_failures == 0 ? "pass" : "FAIL");
+    return test_failures == 0 ? 0 : 1;
+}
+
+// Write value into the payload at bit position pos, most significant bit first
+void putBits(uint8_t* payload, int pos, int length, uint64_t value)
+{
+    for (int i = 0; i < length; i++)
+    {
+        int bit = pos + i;
+        if ((value >> (length - 1 - i)) & 1)
+            payload[bit / 8] |= 0x80 >> (bit % 8);
+        else
+            payload[bit / 8] &= ~(0x80 >> (bit % 8));
+    }
+}
+
+// Frame with the given payload, header and CRC added
+std::vector<uint8_t> rtcmFrame(const std::vector<uint8_t>& payload)
+{
+    size_t length = payload.size();
+    std::vector<uint8_t> frame(length + 6);
+    frame[0] = 0xD3;
+    frame[1] = length >> 8;
+    frame[2] = length;
+    std::copy(payload.begin(), payload.end(), frame.begin() + 3);
+    uint32_t crc = crc24q(frame.data(), length + 3);
+    frame[length + 3] = crc >> 16;
+    frame[length + 4] = crc >> 8;
+    frame[length + 5] = crc;
+    return frame;
+}
+
+// Frame of a message type with length payload bytes of random filler
+std::vector<uint8_t> rtcmMessage(uint16_t message_type, int length)
+{
+    std::vector<uint8_t> payload(length);
+    for (int i = 0; i < length; i++)
+        payload[i] = rand();
+    putBits(payload.data(), 0, 12, message_type);
+    return rtcmFrame(payload);
+}
+
+// MSM frame with a header carrying the epoch time and multiple message bit
+std::vector<uint8_t> rtcmMSM(uint16_t message_type, uint32_t epoch_time, bool multiple, int length = 40)
+{
+    std::vector<uint8_t> payload(length);
+    for (int i = 0; i < length; i++)
+        payload[i] = rand();
+    putBits(payload.data(), 0, 12, message_type);
+    putBits(payload.data(), 12, 12, 1);
+    putBits(payload.data(), 24, 30, epoch_time);
+    putBits(payload.data(), 54, 1, multiple);
+    return rtcmFrame(payload);
+}
+
+// Station reference position message 1005 (m)
+std::vector<uint8_t> rtcm1005(double x, double y, double z)
+{
+    std::vector<uint8_t> payload(19, 0);
+    putBits(payload.data(), 0, 12, 1005);
+    putBits(payload.data(), 12, 12, 1);
+    putBits(payload.data(), 34, 38, (uint64_t)llround(x * 10000.0));
+    putBits(payload.data(), 74, 38, (uint64_t)llround(y * 10000.0));
+    putBits(payload.data(), 114, 38, (uint64_t)llround(z * 10000.0));
+    return rtcmFrame(payload);
+}
+
+#endif
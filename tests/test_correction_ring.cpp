@@ -0,0 +1,107 @@
+/** Correction Ring Test
+ *  Shared ring read by several cursors: frames are never split, a cursor
+ *  cut off part way through a frame is reported, backlog trimming only
+ *  drops whole frames and a cursor can join at a frame still stored
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/correction_ring.h"
+
+CorrectionRing ring;
+
+void pushFrame(uint16_t length, uint8_t fill)
+{
+    std::vector<uint8_t> frame(length, fill);
+    ring.push(frame.data(), length, 1074, 0, false);
+}
+
+// Read up to max_bytes from a cursor into out
+void readCursor(RingCursor& cursor, uint32_t max_bytes, std::vector<uint8_t>& out)
+{
+    uint32_t length;
+    const uint8_t* data;
+    while (max_bytes > 0 && (data = ring.peek(cursor, length)) != NULL)
+    {
+        if (length > max_bytes)
+            length = max_bytes;
+        out.insert(out.end(), data, data + length);
+        ring.advance(cursor, length);
+        max_bytes -= length;
+    }
+}
+
+int main()
+{
+    // Two cursors see the same frames in order
+    RingCursor fast, slow;
+    ring.attach(fast);
+    ring.attach(slow);
+    for (int i = 0; i < 10; i++)
+        pushFrame(100, i);
+    std::vector<uint8_t> fast_data, slow_data;
+    readCursor(fast, 100000, fast_data);
+    readCursor(slow, 100000, slow_data);
+    CHECK(fast_data.size() == 1000);
+    CHECK(fast_data == slow_data);
+    CHECK(ring.pending(fast) == 0);
+
+    // Trimming drops whole frames and leaves a partly sent frame alone
+    for (int i = 0; i < 20; i++)
+        pushFrame(100, i);
+    slow_data.clear();
+    readCursor(slow, 50, slow_data);
+    ring.trim(slow, 500);
+    CHECK(slow.frames_dropped == 0);
+    CHECK(ring.pending(slow) == 1950);
+    readCursor(slow, 50, slow_data);
+    ring.trim(slow, 500);
+    CHECK(slow.frames_dropped == 14);
+    CHECK(ring.pending(slow) == 500);
+    CHECK(ring.catchUp(slow));
+
+    // Overwriting the frame a cursor is part way through is reported so the
+    // client can be closed instead of being sent the rest of another frame
+    RingCursor stalled;
+    ring.attach(stalled);
+    pushFrame(1000, 0xAA);
+    std::vector<uint8_t> stalled_data;
+    readCursor(stalled, 10, stalled_data);
+    for (int i = 0; i < 40; i++)
+        pushFrame(1000, i);
+    CHECK(!ring.catchUp(stalled));
+    CHECK(stalled.offset == 0);
+    CHECK(stalled.frames_missed > 0);
+
+    // A cursor between frames just skips the overwritten ones
+    RingCursor idle;
+    ring.attach(idle);
+    for (int i = 0; i < 40; i++)
+        pushFrame(1000, i);
+    CHECK(ring.catchUp(idle));
+    CHECK(idle.frames_missed > 0);
+    CHECK(ring.pending(idle) <= RING_DATA_SIZE);
+
+    // A cursor attached at the start of the current epoch is sent the
+    // frames of the epoch already stored, once the start is overwritten it
+    // cannot be attached there
+    std::vector<uint8_t> frame(100, 0x55);
+    ring.push(frame.data(), 100, 1077, 0, true);
+    uint32_t epoch_start = ring.epochFrame();
+    CHECK(epoch_start == ring.headFrame());
+    pushFrame(100, 1);
+    pushFrame(100, 2);
+    RingCursor joined = {};
+    CHECK(ring.attachAt(joined, epoch_start));
+    CHECK(ring.pending(joined) == 200);
+    CHECK(!ring.attachAt(joined, ring.headFrame() + 1));
+    for (int i = 0; i < 40; i++)
+        pushFrame(1000, i);
+    RingCursor late = {};
+    CHECK(!ring.attachAt(late, epoch_start));
+    CHECK(ring.attachAt(late, ring.headFrame()));
+    CHECK(ring.pending(late) == 0);
+
+    return testResult("correction_ring");
+}
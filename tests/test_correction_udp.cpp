@@ -0,0 +1,66 @@
+/** UDP Correction Transport Test
+ *  Rover side of the UDP transport fed with the base's datagrams: parity
+ *  recovery, frames kept in order, late datagrams of earlier groups dropped
+ *  and sequence numbers wrapping around
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#include "udp_harness.h"
+
+std::vector<std::vector<uint8_t>> makeFrames(int count)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < count; i++)
+        frames.push_back(rtcmMessage(1074, 20 + (i * 13) % 200));
+    return frames;
+}
+
+int main()
+{
+    crc24qInit();
+    srand(3);
+
+    // One lost datagram per group is rebuilt, frames come out in order
+    {
+        std::vector<std::vector<uint8_t>> frames = makeFrames(16);
+        std::vector<Datagram> datagrams = sendFrames(frames, 100, 4);
+        Rover rover;
+        for (size_t i = 0; i < datagrams.size(); i++)
+            if (i % 5 != 1)
+                rover.receive(datagrams[i]);
+        CHECK(rover.written == frames);
+        CHECK(rover.fec.recovered == 4);
+    }
+
+    // A late datagram of the previous group must not flush the current
+    // group before its parity arrives, or be written out of order
+    {
+        std::vector<std::vector<uint8_t>> frames = makeFrames(8);
+        std::vector<Datagram> datagrams = sendFrames(frames, 0, 4);
+        // Group 0: data 0-3 parity 4, group 1: data 5-8 parity 9
+        Rover rover;
+        for (int i : {0, 2, 3, 4, 5, 7, 1, 8, 9})
+            rover.receive(datagrams[i]);
+        std::vector<std::vector<uint8_t>> expected = frames;
+        CHECK(rover.written == expected);
+        CHECK(rover.fec.recovered == 2);
+        CHECK(rover.fec.late == 1);
+    }
+
+    // Groups across the wrap of the sequence number
+    {
+        std::vector<std::vector<uint8_t>> frames = makeFrames(12);
+        std::vector<Datagram> datagrams = sendFrames(frames, 0xFFFFFFFA, 4);
+        Rover rover;
+        for (size_t i = 0; i < datagrams.size(); i++)
+            if (i != 7)
+                rover.receive(datagrams[i]);
+        CHECK(rover.written == frames);
+        CHECK(rover.fec.recovered == 1);
+        CHECK(rover.fec.late == 0);
+    }
+
+    return testResult("correction_udp");
+}
@@ -0,0 +1,120 @@
+/** RTCM Framer Test
+ *  Frames split at every byte boundary, noise between frames and corrupted
+ *  frames followed by good ones, through addByte() and addBytes()
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_framer.h"
+
+// Message types of the frames found in stream, added a byte at a time
+std::vector<uint16_t> framesByByte(const std::vector<uint8_t>& stream, RTCMFramer& framer)
+{
+    std::vector<uint16_t> types;
+    for (uint8_t ch : stream)
+        if (framer.addByte(ch))
+            types.push_back(framer.messageType());
+    return types;
+}
+
+// Message types of the frames found in stream, added in blocks of block
+// bytes the way the rover reads its socket
+std::vector<uint16_t> framesByBlock(const std::vector<uint8_t>& stream, size_t block, RTCMFramer& framer)
+{
+    std::vector<uint16_t> types;
+    for (size_t start = 0; start < stream.size(); start += block)
+    {
+        uint16_t length = std::min(block, stream.size() - start);
+        uint16_t used = 0;
+        do
+        {
+            used += framer.addBytes(stream.data() + start + used, length - used);
+            if (framer.frameLength() != 0)
+                types.push_back(framer.messageType());
+        } while (used < length || framer.frameLength() != 0);
+    }
+    return types;
+}
+
+void append(std::vector<uint8_t>& stream, const std::vector<uint8_t>& frame)
+{
+    stream.insert(stream.end(), frame.begin(), frame.end());
+}
+
+int main()
+{
+    crc24qInit();
+    srand(1);
+
+    // Clean stream with noise before and between frames
+    std::vector<uint8_t> stream = {0x01, 0x02, 0xD3, 0x00};
+    std::vector<uint16_t> expected;
+    for (int i = 0; i < 20; i++)
+    {
+        append(stream, rtcmMessage(1071 + i % 7, 10 + i * 37));
+        expected.push_back(1071 + i % 7);
+        if (i % 5 == 0)
+            stream.push_back(0x55);
+    }
+    for (size_t block : {1, 2, 3, 7, 64, 1460, 100000})
+    {
+        RTCMFramer framer;
+        CHECK(framesByBlock(stream, block, framer) == expected);
+    }
+    {
+        RTCMFramer framer;
+        CHECK(framesByByte(stream, framer) == expected);
+    }
+
+    // A corrupted length byte makes the framer swallow the frames after it
+    // before the CRC fails, every good frame buffered after it must still
+    // be found
+    std::vector<uint8_t> bad = rtcmMessage(1005, 19);
+    bad[2] = 0xFF;
+    stream = bad;
+    expected.clear();
+    for (int i = 0; i < 8; i++)
+    {
+        append(stream, rtcmMessage(1074 + i % 3, 20 + i * 3));
+        expected.push_back(1074 + i % 3);
+    }
+    for (size_t block : {1, 5, 64, 1460})
+    {
+        RTCMFramer framer;
+        CHECK(framesByBlock(stream, block, framer) == expected);
+        CHECK(framer.frames_failed == 1);
+    }
+    {
+        // addByte reports the frames buffered after the resync one byte
+        // late, the last is found by the byte after the stream
+        RTCMFramer framer;
+        std::vector<uint8_t> padded = stream;
+        padded.insert(padded.end(), 8, 0x00);
+        CHECK(framesByByte(padded, framer) == expected);
+    }
+    {
+        // Every byte ends up in a frame or counted as discarded
+        RTCMFramer framer;
+        uint32_t frame_bytes = 0;
+        for (uint8_t ch : stream)
+            if (framer.addByte(ch))
+                frame_bytes += framer.frameLength();
+        framer.reset();
+        CHECK(frame_bytes + framer.bytes_discarded == stream.size());
+    }
+
+    // Reset in the middle of a frame drops it and counts a resync
+    {
+        RTCMFramer framer;
+        std::vector<uint8_t> frame = rtcmMessage(1230, 30);
+        for (int i = 0; i < 10; i++)
+            framer.addByte(frame[i]);
+        framer.reset();
+        CHECK(framer.resyncs == 1);
+        CHECK(framer.bytes_discarded == 10);
+        CHECK(framesByByte(frame, framer) == std::vector<uint16_t>{1230});
+    }
+
+    return testResult("rtcm_framer");
+}
@@ -0,0 +1,55 @@
+/** RTCM Statistics Test
+ *  A full table with the largest counters still fits RTCM_STATS_JSON_SIZE,
+ *  and jitter is binned in ms from us arrival times across the wrap of the
+ *  32 bit clock
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#define private public
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_stats.h"
+#undef private
+
+int main()
+{
+    // Frames 1 s apart with the third 3 ms late, which changes the interval
+    // twice. The clock wraps between the first two frames.
+    RTCMStats timed;
+    uint32_t start = 0xFFFFFFFFUL - 500000UL;
+    timed.add(1077, 200, start);
+    timed.add(1077, 200, start + 1000000UL);
+    timed.add(1077, 200, start + 2003000UL);
+    timed.add(1077, 200, start + 3003000UL);
+    timed.add(1077, 200, start + 4003000UL);
+    CHECK(timed.table[0].jitter[2] == 2);
+    CHECK(timed.table[0].jitter[0] == 1);
+
+    RTCMStats stats;
+    for (int i = 0; i < RTCM_STATS_TYPES + 4; i++)
+        stats.add(1000 + i, 1029, i);
+    CHECK(stats.untracked_frames == 4);
+
+    // Widest values on the ESP32, where unsigned long is 32 bits
+    for (int i = 0; i < RTCM_STATS_TYPES; i++)
+    {
+        RTCMTypeStats& entry = stats.table[i];
+        entry.message_type = 4095;
+        entry.frames = 4294967295UL;
+        entry.frame_rate = 1e30;
+        entry.byte_rate = 1e30;
+        entry.min_length = 65535;
+        entry.max_length = 65535;
+        for (int bin = 0; bin < RTCM_JITTER_BINS; bin++)
+            entry.jitter[bin] = 4294967295UL;
+    }
+
+    static char json[RTCM_STATS_JSON_SIZE];
+    int length = stats.toJSON(json, sizeof(json));
+    CHECK(length == (int)strlen(json));
+    CHECK(length < RTCM_STATS_JSON_SIZE - 1);
+    CHECK(json[length - 1] == ']');
+    CHECK(json[length - 2] == '}');
+
+    return testResult("rtcm_stats");
+}
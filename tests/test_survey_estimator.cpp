@@ -0,0 +1,133 @@
+/** Survey Estimator Test
+ *  Replays surveys as 1 Hz streams of 1005 messages through the RTCM decoder
+ *  into the estimator, the same path the base station takes: a settled
+ *  receiver converges after the minimum survey time, a noisy one close to
+ *  its estimated time, single outliers are skipped and the
+ *  receiver finishing its own survey-in restarts the estimate
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_decoder.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/survey_estimator.h"
+
+// Antenna position used for the replays (ECEF, m)
+const double station[3] = {-2694892.4614, -4297418.1926, 3854363.6023};
+
+RTCMDecoder decoder;
+SurveyEstimator survey;
+unsigned long time_ms = 0;
+
+// Normally distributed noise with standard deviation sigma
+double noise(double sigma)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+// Send one 1005 message a second offset from the station position
+void replay(double dx, double dy, double dz)
+{
+    std::vector<uint8_t> frame = rtcm1005(station[0] + dx, station[1] + dy, station[2] + dz);
+    CHECK(decoder.decode(frame.data(), frame.size()) == 1005);
+    survey.addSample(decoder.ecef, time_ms);
+    time_ms += 1000;
+}
+
+// Replay samples with sigma noise on each axis until the survey converges,
+// returns the number of samples used or limit if it did not converge
+unsigned long replayUntilConverged(double sigma, unsigned long limit)
+{
+    for (unsigned long i = 0; i < limit; i++)
+    {
+        replay(noise(sigma), noise(sigma), noise(sigma));
+        if (survey.converged())
+            return survey.num_samples;
+    }
+    return limit;
+}
+
+double meanError()
+{
+    double distance = 0.0;
+    for (int i = 0; i < 3; i++)
+    {
+        double d = survey.meanPosition(i) - station[i];
+        distance += d * d;
+    }
+    return sqrt(distance);
+}
+
+void restart()
+{
+    survey = SurveyEstimator();
+    time_ms = 0;
+}
+
+int main()
+{
+    srand(7);
+    crc24qInit();
+
+    // Receiver without a fix reports a zero position, which is not a sample
+    std::vector<uint8_t> empty = rtcm1005(0.0, 0.0, 0.0);
+    decoder.decode(empty.data(), empty.size());
+    survey.addSample(decoder.ecef, 0);
+    CHECK(!survey.hasPosition());
+    CHECK(survey.timeToConverge() < 0.0);
+
+    // Settled RTK receiver, 1 cm per axis: converges at the minimum time
+    restart();
+    CHECK(replayUntilConverged(0.01, 1000) == SURVEY_MIN_DURATION / 1000 + 1);
+    CHECK(survey.meanSigma() <= SURVEY_MAX_SIGMA);
+    CHECK(meanError() < 0.01);
+    CHECK(survey.timeToConverge() == 0.0);
+    CHECK(survey.restarts == 0);
+
+    // Standalone receiver, 20 cm per axis: about 3 * 0.2^2 / 0.01^2 = 1200
+    // independent samples, one every SURVEY_SAMPLE_SPACING, the estimate
+    // after 100 samples is close to the outcome
+    restart();
+    for (int i = 0; i < 100; i++)
+        replay(noise(0.2), noise(0.2), noise(0.2));
+    CHECK(!survey.converged());
+    double eta = survey.timeToConverge();
+    unsigned long used = replayUntilConverged(0.2, 20000);
+    CHECK(used < 20000);
+    CHECK(used > 1200);
+    double actual = used - 100.0;
+    printf("noisy survey: estimate %.0f s, converged after %.0f s\n", eta, actual);
+    CHECK(eta > 0.7 * actual && eta < 1.3 * actual);
+    CHECK(meanError() < 0.05);
+
+    // Multipath spikes every 20 s are skipped without restarting
+    restart();
+    for (int i = 0; i < 200; i++)
+    {
+        if (i % 20 == 19)
+            replay(1.5, -1.0, 2.0);
+        else
+            replay(noise(0.02), noise(0.02), noise(0.02));
+    }
+    CHECK(survey.outliers == 10);
+    CHECK(survey.restarts == 0);
+    CHECK(survey.num_samples == 190);
+    CHECK(meanError() < 0.01);
+
+    // Receiver finishes its own survey-in and moves its position by 2 m,
+    // the estimate starts again from the new position
+    restart();
+    for (int i = 0; i < 400; i++)
+        replay(2.0 + noise(0.02), noise(0.02), noise(0.02));
+    CHECK(survey.converged());
+    for (int i = 0; i < 400; i++)
+        replay(noise(0.02), noise(0.02), noise(0.02));
+    CHECK(survey.restarts == 1);
+    CHECK(survey.num_samples == 400 - SURVEY_RESET_COUNT + 1);
+    CHECK(survey.converged());
+    CHECK(meanError() < 0.01);
+
+    return testResult("survey_estimator");
+}
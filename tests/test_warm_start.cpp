@@ -0,0 +1,59 @@
+/** Warm Start Test
+ *  Snapshots keep being refreshed while a client is stuck reading one, and
+ *  a reader always sees the snapshot it started with
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/warm_start.h"
+
+WarmStartCache cache;
+
+// Station frame and a one frame epoch marked with the epoch number
+void addEpoch(uint8_t number)
+{
+    std::vector<uint8_t> station = {0xD3, 0x00, 0x13, 0x3E, 0xD0};
+    station.resize(25, 0);
+    cache.add(station.data(), station.size(), 1005, false, false);
+
+    std::vector<uint8_t> msm(40, number);
+    cache.add(msm.data(), msm.size(), 1074, true, true);
+}
+
+uint8_t snapshotEpoch(uint8_t index)
+{
+    return cache.data(index)[cache.length(index) - 1];
+}
+
+int main()
+{
+    addEpoch(1);
+    CHECK(cache.published == 1);
+
+    // A stuck reader keeps its snapshot, later epochs are still published
+    uint8_t stuck = cache.acquire();
+    CHECK(snapshotEpoch(stuck) == 1);
+    for (uint8_t epoch = 2; epoch <= 5; epoch++)
+        addEpoch(epoch);
+    CHECK(snapshotEpoch(stuck) == 1);
+    CHECK(cache.published == 5);
+    CHECK(cache.skipped == 0);
+
+    // A new client gets the latest epoch
+    uint8_t fresh = cache.acquire();
+    CHECK(fresh != stuck);
+    CHECK(snapshotEpoch(fresh) == 5);
+
+    // Both snapshots being read skips publishing until one is released
+    addEpoch(6);
+    CHECK(cache.skipped == 1);
+    CHECK(snapshotEpoch(fresh) == 5);
+    cache.release(stuck);
+    addEpoch(7);
+    uint8_t next = cache.acquire();
+    CHECK(snapshotEpoch(next) == 7);
+    CHECK(snapshotEpoch(fresh) == 5);
+
+    return testResult("warm_start");
+}
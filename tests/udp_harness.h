@@ -0,0 +1,100 @@
+/** UDP Harness
+ *  Base and rover sides of the UDP correction transport for the host tests
+ *  and the FEC simulation, without the sockets
+ *  Copyright Tinkerbug Robotics 2023
+ *  Provided under GNU GPL 3.0 License
+ */
+
+#ifndef UDP_HARNESS_H
+#define UDP_HARNESS_H
+
+#include "rtcm_test.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/rtcm_framer.h"
+#include "../ESP32-BaseStation-WiFi-DirectTransmit/correction_udp.h"
+
+struct Datagram
+{
+    UDPHeader header;
+    std::vector<uint8_t> payload;
+};
+
+// Base side: data datagrams and a parity datagram for every group, groups
+// are also closed after every epoch_frames frames when it is not zero. A
+// group of zero sends no parity.
+std::vector<Datagram> sendFrames(const std::vector<std::vector<uint8_t>>& frames, uint32_t sequence,
+                                 uint8_t group, size_t epoch_frames = 0)
+{
+    std::vector<Datagram> out;
+    UDPParityEncoder parity;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        UDPHeader header = {0, sequence, 0, parity.count, 0, 1};
+        out.push_back({header, frames[i]});
+        parity.add(sequence, frames[i].data(), frames[i].size());
+        sequence++;
+
+        bool epoch_end = epoch_frames > 0 && (i + 1) % epoch_frames == 0;
+        if (group == 0)
+        {
+            parity.reset();
+        }
+        else if (parity.count == group || epoch_end || i + 1 == frames.size())
+        {
+            UDPHeader parity_header = {UDP_FLAG_PARITY, parity.first_sequence, 0, 0, parity.count, 0};
+            out.push_back({parity_header, std::vector<uint8_t>(parity.data(), parity.data() + parity.length())});
+            parity.reset();
+        }
+    }
+    return out;
+}
+
+// Rover side, as readAndSendUDPData() and sendUDPFrames() in the sketch
+class Rover
+{
+  public:
+
+    void receive(const Datagram& datagram)
+    {
+        const UDPHeader& header = datagram.header;
+        bool parity = header.flags & UDP_FLAG_PARITY;
+        uint32_t first_sequence = parity ? header.sequence : header.sequence - header.fec_index;
+        if (!parity && !tracker.update(header.sequence))
+            return;
+
+        if (fec.isNewGroup(first_sequence))
+        {
+            fec.finishGroup();
+            drain();
+        }
+        if (parity)
+            fec.addParity(first_sequence, header.fec_count, datagram.payload.data(), datagram.payload.size());
+        else
+            fec.addData(first_sequence, header.fec_index, datagram.payload.data(), datagram.payload.size(),
+                        header.timestamp, millis());
+        drain();
+    }
+
+    void drain()
+    {
+        uint16_t length;
+        uint32_t timestamp;
+        const uint8_t* frame;
+        while ((frame = fec.next(length, timestamp)) != NULL)
+        {
+            uint16_t used = 0;
+            do
+            {
+                used += framer.addBytes(frame + used, length - used);
+                if (framer.frameLength() != 0)
+                    written.push_back(std::vector<uint8_t>(framer.frame(), framer.frame() + framer.frameLength()));
+            } while (used < length || framer.frameLength() != 0);
+        }
+    }
+
+    UDPSequenceTracker tracker;
+    UDPParityDecoder fec;
+    RTCMFramer framer;
+    std::vector<std::vector<uint8_t>> written;
+};
+
+#endif